@@ -0,0 +1,136 @@
+#include "tbaffine.h"
+#include "Wm5APoint.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TB_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+const TBAffine TBAffine::IDENTITY;
+
+TBAffine::TBAffine()
+{
+	for (int i=0; i<12; i++) {
+		mEntry[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	}
+}
+
+TBAffine::TBAffine(const Transform &xform)
+{
+	// Sample the transform at the origin and the unit points instead of
+	// reading its matrix, so the row/column convention of Wm5 does not leak
+	// in here.
+	APoint origin = xform * APoint(0.0f, 0.0f, 0.0f);
+	APoint axes[3] = {
+		xform * APoint(1.0f, 0.0f, 0.0f),
+		xform * APoint(0.0f, 1.0f, 0.0f),
+		xform * APoint(0.0f, 0.0f, 1.0f)
+	};
+
+	for (int row=0; row<3; row++) {
+		for (int col=0; col<3; col++) {
+			mEntry[row*4 + col] = axes[col][row] - origin[row];
+		}
+		mEntry[row*4 + 3] = origin[row];
+	}
+}
+
+bool TBAffine::isIdentity() const
+{
+	for (int i=0; i<12; i++) {
+		if (mEntry[i] != IDENTITY.mEntry[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+float TBAffine::operator()(int row, int col) const
+{
+	return mEntry[row*4 + col];
+}
+
+TBAffine TBAffine::then(const TBAffine &next) const
+{
+	TBAffine result;
+	for (int row=0; row<3; row++) {
+		for (int col=0; col<4; col++) {
+			float sum = col == 3 ? next.mEntry[row*4 + 3] : 0.0f;
+			for (int k=0; k<3; k++) {
+				sum += next.mEntry[row*4 + k] * mEntry[k*4 + col];
+			}
+			result.mEntry[row*4 + col] = sum;
+		}
+	}
+	return result;
+}
+
+Vector3f TBAffine::operator*(const Vector3f &point) const
+{
+	Vector3f result;
+	applyScalar((const float *)&point, (float *)&result, 1);
+	return result;
+}
+
+void TBAffine::applyScalar(const float *src, float *dst, int count) const
+{
+	const float *m = mEntry;
+	for (int i=0; i<count; i++, src+=3, dst+=3) {
+		float x = src[0];
+		float y = src[1];
+		float z = src[2];
+		dst[0] = m[0]*x + m[1]*y + m[2]*z + m[3];
+		dst[1] = m[4]*x + m[5]*y + m[6]*z + m[7];
+		dst[2] = m[8]*x + m[9]*y + m[10]*z + m[11];
+	}
+}
+
+void TBAffine::apply(const Vector3f *src, Vector3f *dst, int count) const
+{
+	// Vector3f is three packed floats, so the arrays are read as xyzxyz...
+	const float *in = (const float *)src;
+	float *out = (float *)dst;
+
+#ifdef TB_USE_SSE
+	const float *m = mEntry;
+	__m128 m00 = _mm_set1_ps(m[0]), m01 = _mm_set1_ps(m[1]), m02 = _mm_set1_ps(m[2]), m03 = _mm_set1_ps(m[3]);
+	__m128 m10 = _mm_set1_ps(m[4]), m11 = _mm_set1_ps(m[5]), m12 = _mm_set1_ps(m[6]), m13 = _mm_set1_ps(m[7]);
+	__m128 m20 = _mm_set1_ps(m[8]), m21 = _mm_set1_ps(m[9]), m22 = _mm_set1_ps(m[10]), m23 = _mm_set1_ps(m[11]);
+
+	int blocks = count / 4;
+	for (int i=0; i<blocks; i++, in+=12, out+=12) {
+		// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+		__m128 a = _mm_loadu_ps(in);
+		__m128 b = _mm_loadu_ps(in + 4);
+		__m128 c = _mm_loadu_ps(in + 8);
+
+		// Deinterleave into x0..x3, y0..y3 and z0..z3.
+		__m128 t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+		__m128 x = _mm_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 u = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+		__m128 v = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+		__m128 y = _mm_shuffle_ps(u, v, _MM_SHUFFLE(2, 0, 2, 0));
+		u = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+		v = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+		__m128 z = _mm_shuffle_ps(u, v, _MM_SHUFFLE(2, 0, 2, 0));
+
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m01, y)), _mm_mul_ps(m02, z)), m03);
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, x), _mm_mul_ps(m11, y)), _mm_mul_ps(m12, z)), m13);
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, x), _mm_mul_ps(m21, y)), _mm_mul_ps(m22, z)), m23);
+
+		// Interleave back into xyz triples.
+		u = _mm_shuffle_ps(rx, ry, _MM_SHUFFLE(0, 0, 0, 0));
+		v = _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(1, 1, 0, 0));
+		_mm_storeu_ps(out, _mm_shuffle_ps(u, v, _MM_SHUFFLE(2, 0, 2, 0)));
+		u = _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(1, 1, 1, 1));
+		v = _mm_shuffle_ps(rx, ry, _MM_SHUFFLE(2, 2, 2, 2));
+		_mm_storeu_ps(out + 4, _mm_shuffle_ps(u, v, _MM_SHUFFLE(2, 0, 2, 0)));
+		u = _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(3, 3, 2, 2));
+		v = _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(3, 3, 3, 3));
+		_mm_storeu_ps(out + 8, _mm_shuffle_ps(u, v, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+	count -= blocks * 4;
+#endif
+
+	applyScalar(in, out, count);
+}
@@ -0,0 +1,43 @@
+#ifndef TBAFFINE_H
+#define TBAFFINE_H
+
+#include "Wm5Vector3.h"
+#include "Wm5Transform.h"
+
+using namespace Wm5;
+
+// Affine map y = A * x + t stored as a row-major 3x4 matrix.
+//
+// Several Wm5 Transforms can be composed into one TBAffine so that a batch
+// of transforms costs a single pass over the vertices. apply() runs an SSE
+// kernel that transforms four vertices per iteration when the compiler
+// targets SSE, and a scalar loop otherwise.
+class TBAffine
+{
+	public:
+		TBAffine();
+		TBAffine(const Transform &xform);
+
+		bool isIdentity() const;
+
+		// Returns the map that applies this one first and then next.
+		TBAffine then(const TBAffine &next) const;
+
+		Vector3f operator*(const Vector3f &point) const;
+
+		// Transforms count points from src into dst. src and dst may be the
+		// same array; partially overlapping ranges are not supported.
+		void apply(const Vector3f *src, Vector3f *dst, int count) const;
+
+		float operator()(int row, int col) const;
+
+		static const TBAffine IDENTITY;
+
+	private:
+		void applyScalar(const float *src, float *dst, int count) const;
+
+	private:
+		float mEntry[12];
+};
+
+#endif
@@ -7,8 +7,9 @@
 // File Version: 5.0.1 (2012/07/07)
 
 #include "tbapplication.h"
-#include "Wm5ConvexHull3.h"
-#include "tbmeshboolean.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 
 WM5_WINDOW_APPLICATION(TBApplication);
 
@@ -20,6 +21,8 @@ TBApplication::TBApplication ()
         Float4(1.0f, 1.0f, 1.0f, 1.0f))
 {
     Environment::InsertDirectory(ThePath + "Data/");
+    mRotorMesh = 0;
+    mUndoRotorMesh = 0;
 }
 
 TBApplication::~TBApplication ()
@@ -29,14 +32,19 @@ TBApplication::~TBApplication ()
 
 void TBApplication::InitializeDataModel ()
 {
-    mBeginTridCircles[0] = Circle3f(Vector3f(-2, 0, 0), Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 1), 0.5);
-    mBeginTridCircles[1] = Circle3f(Vector3f(0, 0, 0), Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 1), 1.0);
-    mBeginTridCircles[2] = Circle3f(Vector3f(3, 0, 0), Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 1), 0.5);
-    mEndTridCircles[0] = Circle3f(Vector3f(-1, 0, 10), Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 1), 0.1);
-    mEndTridCircles[1] = Circle3f(Vector3f(0, 0, 10), Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 1), 0.2);
-    mEndTridCircles[2] = Circle3f(Vector3f(1, 0, 10), Vector3f(1, 0, 0), Vector3f(0, 1, 0), Vector3f(0, 0, 1), 0.1);
-    mInterpoStep = 10;
-    mHeight = 10;
+    mRotorParams = TBRotorParams();
+    mUndoRotorParams = mRotorParams;
+    mSelectedCircle = 0;
+    // The mesh cache is opt in: it writes a file per rotor and tolerance.
+    const char* cacheDirectory = getenv("TURBGIZ_MESH_CACHE");
+    mMeshCacheDirectory = cacheDirectory ? cacheDirectory : "";
+    if (!mMeshCacheDirectory.empty() && *mMeshCacheDirectory.rbegin() != '/')
+    {
+        mMeshCacheDirectory += '/';
+    }
+    mExportPath = "rotor.stl";
+    mCreaseAngle = 40.0f * Mathf::PI / 180.0f;
+    mOptimizeIndices = true;
 }
 
 bool TBApplication::OnInitialize ()
@@ -79,6 +87,9 @@ bool TBApplication::OnInitialize ()
 void TBApplication::OnTerminate ()
 {
     mScene = 0;
+    mUndoRotor = 0;
+    delete0(mRotorMesh);
+    delete0(mUndoRotorMesh);
     mWireState = 0;
     mCullState = 0;
     WindowApplication3::OnTerminate();
@@ -118,10 +129,121 @@ bool TBApplication::OnKeyDown (unsigned char key, int x, int y)
     case 'W':
         mWireState->Enabled = !mWireState->Enabled;
         return true;
+    case 'x':
+    case 'X':
+    {
+        // The welded boolean result, not the render mesh, whose vertices
+        // are split at the creases.
+        TBMeshExporter::Status status = TBMeshExporter::save(mExportPath.c_str(), *mRotorMesh);
+        printf("%s: %s\n", mExportPath.c_str(), TBMeshExporter::getStatusName(status));
+        return true;
+    }
     }
 
+    if (EditRotor(key))
+    {
+        return true;
+    }
     return WindowApplication::OnKeyDown(key, x, y);
 }
+//----------------------------------------------------------------------------
+bool TBApplication::EditRotor (unsigned char key)
+{
+    // c/C select the next or previous circle, +/- scale it, j/l and i/k
+    // move it along x and y; n/N, b/B and p/P change the steps, the number
+    // of wings and the pitch; u undoes the last edit and a second u redoes
+    // it.
+    TBRotorParams params = mRotorParams;
+    int numCircles = (int)params.beginCircles.size();
+    Circle3f& circle = (mSelectedCircle < numCircles ?
+        params.beginCircles[mSelectedCircle] :
+        params.endCircles[mSelectedCircle - numCircles]);
+    const float move = 0.1f;
+    const float pitch = 5.0f * Mathf::DEG_TO_RAD;
+
+    switch (key)
+    {
+    case 'c':
+    case 'C':
+        mSelectedCircle += (key == 'c' ? 1 : 2 * numCircles - 1);
+        mSelectedCircle %= 2 * numCircles;
+        printf("%s circle %d\n", mSelectedCircle < numCircles ? "begin" : "end",
+            mSelectedCircle % numCircles);
+        return true;
+    case '+': circle.Radius *= 1.1f; break;
+    case '-': circle.Radius /= 1.1f; break;
+    case 'j': circle.Center.X() -= move; break;
+    case 'l': circle.Center.X() += move; break;
+    case 'k': circle.Center.Y() -= move; break;
+    case 'i': circle.Center.Y() += move; break;
+    case 'n': params.numSteps--; break;
+    case 'N': params.numSteps++; break;
+    case 'b': params.numWings--; break;
+    case 'B': params.numWings++; break;
+    case 'p': params.wingPitch -= pitch; break;
+    case 'P': params.wingPitch += pitch; break;
+    case 'u':
+    {
+        if (!mUndoRotor)
+        {
+            printf("Nothing to undo\n");
+            return true;
+        }
+        // The rotor before the last edit is still built.
+        NodePtr rotor = mRotor;
+        SetRotor(mUndoRotor);
+        mUndoRotor = rotor;
+        std::swap(mRotorMesh, mUndoRotorMesh);
+        std::swap(mRotorParams, mUndoRotorParams);
+        return true;
+    }
+    default:
+        return false;
+    }
+
+    std::string problem = params.check();
+    if (!problem.empty())
+    {
+        printf("Edit refused: %s\n", problem.c_str());
+        return true;
+    }
+    TBRotorParams previous = mRotorParams;
+    mRotorParams = params;
+    if (!RegenerateRotor())
+    {
+        printf("Edit refused: the rotor boolean failed\n");
+        mRotorParams = previous;
+        return true;
+    }
+    mUndoRotorParams = previous;
+    return true;
+}
+//----------------------------------------------------------------------------
+bool TBApplication::RegenerateRotor ()
+{
+    TBMesh* finest = new0 TBMesh();
+    Node* rotor = CreateLodChain(false, *finest);
+    if (!rotor)
+    {
+        delete0(finest);
+        return false;
+    }
+    mUndoRotor = mRotor;
+    SetRotor(rotor);
+    delete0(mUndoRotorMesh);
+    mUndoRotorMesh = mRotorMesh;
+    mRotorMesh = finest;
+    return true;
+}
+//----------------------------------------------------------------------------
+void TBApplication::SetRotor (Node* rotor)
+{
+    mScene->DetachChild(mRotor);
+    mRotor = rotor;
+    mScene->AttachChild(mRotor);
+    mScene->Update();
+    mCuller.ComputeVisibleSet(mScene);
+}
 
 
 //----------------------------------------------------------------------------
@@ -153,139 +275,49 @@ void TBApplication::CreateScene ()
     mEffect = effectDV->CreateInstance(light, steel);
 
     // Create mesh.
-    mScene->AttachChild(CreateMesh());
-}
-
-void TBApplication::CreateSamples(const Circle3f& circle1,
-                                  const Circle3f& circle2,
-                                  const Circle3f& circle3,
-                                  std::vector<Vector3f>& vertices,
-                                  float height) {
-
-    TridCircle *tc = new0 TridCircle(circle1, circle2, circle3);
-    BSplineCurve3f *pSpline = tc->CreateCircle();
+    mRotorMesh = new0 TBMesh();
+    mRotor = CreateLodChain(true, *mRotorMesh);
+    assertion(mRotor != 0, "The rotor parameters do not make a valid rotor.\n");
+    mScene->AttachChild(mRotor);
 
-    float mult = 1.0f/20;
-    int i = 0;
-    for (; i < 20; ++i)
+    // Edits rebuild the chain quietly; the reports are printed once here.
+    for (size_t i = 0; i < mCacheReports.size(); ++i)
     {
-        Vector3f pos = pSpline->GetPosition(mult * i);
-        // TridCircle always compute the circle on xy plane.
-        pos.Z() = height;
-        vertices.push_back(pos);
+        printf("Level %d vertex cache misses per triangle: %.3f, optimized %.3f\n",
+            (int)i, mCacheReports[i].acmrBefore, mCacheReports[i].acmrAfter);
     }
-    delete0(tc);
-    delete0(pSpline);
 }
 
-Circle3f TBApplication::LinearCircleInterpolate(const Circle3f& circleBegin, const Circle3f& circleEnd,
-                                                int count, int index) {
-    // Compute center position.
-    Vector3f dir = circleEnd.Center - circleBegin.Center;
-    float distance = dir.Normalize();
-    Vector3f center = circleBegin.Center + dir * (distance * (index * 1.0 / count));
-
-    float radius = circleBegin.Radius + (circleEnd.Radius - circleBegin.Radius) * (index * 1.0 / count);
-    return Circle3f(center, circleBegin.Direction0, circleBegin.Direction1, circleBegin.Normal, radius);
-}
-
-void TBApplication::CreateBody(TBMesh &mesh)
-{
-    // Create bottom faces.
-    int sampleCount = 20;
-    float harfHeight = 2;
-    float radius = 4;
-    Vector3f *vertices = new1<Vector3f>(sampleCount * 2 + 2 );
-    float angle = Mathf::TWO_PI / sampleCount;
-    for (int i = 0; i < sampleCount; ++i)
-    {
-        float x = radius * Mathf::Cos(angle * i);
-        float y = radius * Mathf::Sin(angle * i);
-        vertices[i] = Vector3f(x, y, -harfHeight);
-        vertices[i + sampleCount] = Vector3f(x, y, harfHeight);
-    }
-
-    vertices[sampleCount * 2] = Vector3f(0, 0, -harfHeight - 0.01);
-    vertices[sampleCount * 2 + 1] = Vector3f(0, 0, harfHeight + 0.01);
-
-    ConvexHull3f *pHull = new0 ConvexHull3f(sampleCount * 2 + 2, vertices, 0.0001f, false, Query::QT_REAL);
-
-    int numTriangles = pHull->GetNumSimplices();
-    const int* hullIndices = pHull->GetIndices();
-    for (int i=0; i<numTriangles; i++) {
-        int p1 = hullIndices[i*3];
-        int p2 = hullIndices[i*3 + 1];
-        int p3 = hullIndices[i*3 + 2];
+TriMesh* TBApplication::CreateTriMesh(const TBMesh &mesh) {
 
-        mesh.addTriangle(vertices[p1], vertices[p2], vertices[p3]);
+    // The index buffer size is known up front, so the split writes the
+    // indices straight into it; the vertex buffer is sized from the split.
+    int indexCount = mesh.getIndices().size() / 3 * 3;
+    IndexBuffer* ibuffer = new0 IndexBuffer(indexCount, sizeof(int));
+    int* indices = (int*)ibuffer->GetData();
+    std::vector<int> sources;
+    std::vector<Vector3f> normals;
+    mesh.splitNormals(mCreaseAngle, indices, sources, normals);
+    int vertexCount = sources.size();
+
+    // Reorder for the vertex caches, in place; the vertex fill below reads
+    // through order, so the vertices follow without being copied.
+    std::vector<int> order;
+    if (mOptimizeIndices && indexCount > 0) {
+        mCacheReports.push_back(TBCacheOptimizer::optimize(indices, indexCount, vertexCount, order));
     }
 
-    delete1(vertices);
-    delete0(pHull);
-}
-
-void TBApplication::CreateWing(TBMesh &mesh)
-{
-    std::vector<Vector3f> samples;
-    std::vector<Vector3f> delaunaySamples;
-    int sampleCount = 20;
-    int delaunaySamplesCount = sampleCount * 2;
-
-    // Create faces.
-    CreateSamples(mBeginTridCircles[0], mBeginTridCircles[1], mBeginTridCircles[2], samples, 0);
-    for (int step = 1; step < mInterpoStep+1; step++) {
-
-        float height = step * (mHeight * (1.0 / mInterpoStep));
-
-        Circle3f cir1 = LinearCircleInterpolate(mBeginTridCircles[0], mEndTridCircles[0], mInterpoStep, step);
-        Circle3f cir2 = LinearCircleInterpolate(mBeginTridCircles[1], mEndTridCircles[1], mInterpoStep, step);
-        Circle3f cir3 = LinearCircleInterpolate(mBeginTridCircles[2], mEndTridCircles[2], mInterpoStep, step);
-
-        delaunaySamples.clear();
-        delaunaySamples.insert(delaunaySamples.end(), samples.begin(), samples.end());
-        samples.clear();
-        CreateSamples(cir1, cir2, cir3, samples, height);
-        delaunaySamples.insert(delaunaySamples.end(), samples.begin(), samples.end());
-
-        Vector3f *vertices = new1<Vector3f>(sampleCount * 2);
-        int i = 0;
-        for (std::vector<Vector3f>::iterator it = delaunaySamples.begin();
-            it != delaunaySamples.end(); it++, i++) {
-            Vector3f pos = *it;
-            vertices[i] = pos;
-        }
-        ConvexHull3f *pHull = new0 ConvexHull3f(sampleCount * 2, vertices, 0.0001f, false, Query::QT_REAL);
-
-        int numTriangles = pHull->GetNumSimplices();
-        const int* hullIndices = pHull->GetIndices();
-        for (int i=0; i<numTriangles; i++) {
-
-            int p1 = hullIndices[i*3];
-            int p2 = hullIndices[i*3 + 1];
-            int p3 = hullIndices[i*3 + 2];
-
-            bool isFaceOnTop = p1 >= sampleCount && p2 >= sampleCount && p3 >= sampleCount;
-            bool isFaceOnBottom = p1 < sampleCount && p2 < sampleCount && p3 < sampleCount;
-            if (isFaceOnTop && step != mInterpoStep) {
-                continue;
-            }
-            if (isFaceOnBottom && step != 1) {
-                continue;
-            }
-            mesh.addTriangle(vertices[p1], vertices[p2], vertices[p3]);
+    // 16-bit indices whenever the vertices fit; the 32-bit buffer is only
+    // a temporary then.
+    if (vertexCount <= 65536) {
+        IndexBuffer* narrow = new0 IndexBuffer(indexCount, sizeof(unsigned short));
+        unsigned short* indicesBuf = (unsigned short*)narrow->GetData();
+        for (int j = 0; j < indexCount; ++j) {
+            indicesBuf[j] = (unsigned short)indices[j];
         }
-
-        delete0(pHull);
-        delete1(vertices);
+        delete0(ibuffer);
+        ibuffer = narrow;
     }
-}
-
-TriMesh* TBApplication::CreateTriMesh(const TBMesh &mesh) {
-
-    std::vector<Vector3f> vertices;
-    std::vector<int> indices;
-    std::vector<Vector3f> normals;
-    ComputeNormals(mesh, vertices, indices, normals);
 
     // Create TriMesh for rendering. The normals are duplicated to texture
     // coordinates to avoid the AMD lighting problems due to use of
@@ -295,25 +327,16 @@ TriMesh* TBApplication::CreateTriMesh(const TBMesh &mesh) {
         VertexFormat::AU_NORMAL, VertexFormat::AT_FLOAT3, 0,
         VertexFormat::AU_TEXCOORD, VertexFormat::AT_FLOAT3, 1);
 
+    // One pass over the output vertices fills the interleaved buffer.
+    const std::vector<Vector3f>& vertices = mesh.getVertices();
     int vstride = vformat->GetStride();
-    VertexBuffer* vbuffer = new0 VertexBuffer(vertices.size(), vstride);
+    VertexBuffer* vbuffer = new0 VertexBuffer(vertexCount, vstride);
     VertexBufferAccessor vba(vformat, vbuffer);
-    Float4 lightGray(0.75f, 0.75f, 0.75f, 1.0f);
-    std::vector<Vector3f>::const_iterator it =  vertices.begin();
-    for (int j=0; it != vertices.end(); it++, j++) {
-        vba.Position<Vector3f>(j) = *it;
-        Vector3f &normal = normals[j];
-        vba.Normal<Vector3f>(j) = normal;
-        vba.TCoord<Vector3f>(1, j) = normal;
-    }
-
-    int indexCount = indices.size();
-    IndexBuffer* ibuffer = new0 IndexBuffer(indexCount, sizeof(int));
-    int* indicesBuf = (int*)ibuffer->GetData();
-
-    std::vector<int>::const_iterator iit = indices.begin();
-    for (int j=0; iit != indices.end(); iit++, j++) {
-        indicesBuf[j] = *iit; 
+    for (int j = 0; j < vertexCount; ++j) {
+        int split = order.empty() ? j : order[j];
+        vba.Position<Vector3f>(j) = vertices[sources[split]];
+        vba.Normal<Vector3f>(j) = normals[split];
+        vba.TCoord<Vector3f>(1, j) = normals[split];
     }
 
     TriMesh* tetra = new0 TriMesh(vformat, vbuffer, ibuffer);
@@ -322,88 +345,83 @@ TriMesh* TBApplication::CreateTriMesh(const TBMesh &mesh) {
     return tetra;
 }
 
-TriMesh* TBApplication::CreateMesh()
+Node* TBApplication::CreateLodChain(bool useCache, TBMesh& finest)
 {
-    // Create Wings.
-    TBMesh *wing1 = new0 TBMesh();
-    CreateWing(*wing1);
-    Transform rotate;
-    rotate.SetRotate(HMatrix(AVector::UNIT_Z, 25.0 * Mathf::PI / 180.0));
-    wing1->transformBy(rotate);
-    Transform trans;
-    trans.SetTranslate(Vector3f(-0.5, 0.0, 2.5));
-    wing1->transformBy(trans);
-
-    TBMesh *wing2 = wing1->clone();
-    Transform rotate2;
-    rotate2.SetRotate(HMatrix(AVector::UNIT_Y, 120.0 * Mathf::PI / 180.0));
-    wing2->transformBy(rotate2);
-
-    TBMesh *wing3 = wing1->clone();
-    Transform rotate3;
-    rotate3.SetRotate(HMatrix(AVector::UNIT_Y, -120.0 * Mathf::PI / 180.0));
-    wing3->transformBy(rotate3);
-
-    TBMesh *body = new0 TBMesh();
-    CreateBody(*body);
-    Transform xform;
-    xform.SetRotate(HMatrix(AVector::UNIT_X, Mathf::PI / 2.0));
-    body->transformBy(xform);
-
-    // Boolean wings and body.
-    TBMesh *result1 = new0 TBMesh();
-    TBBoolean::add(*wing1, *body, *result1);
-    TBMesh *result2 = new0 TBMesh();
-    TBBoolean::add(*wing2, *result1, *result2);
-    TBMesh *result3 = new0 TBMesh();
-    TBBoolean::add(*wing3, *result2, *result3);
-
-    TriMesh* tMesh = CreateTriMesh(*result3);
-
-    delete0(wing1);
-    delete0(wing2);
-    delete0(wing3);
-    delete0(body);
-    delete0(result1);
-    delete0(result2);
-    delete0(result3);
-
-    return tMesh;
+    // Each level is regenerated with a five times coarser tolerance and
+    // used until the rotor covers less than the given part of the viewport.
+    const float minScreenSizes[LOD_LEVELS] = { 0.25f, 0.06f, 0.0f };
+
+    TBLodNode* lodNode = new0 TBLodNode();
+    mCacheReports.clear();
+    float tolerance = mRotorParams.chordTolerance;
+    for (int i = 0; i < LOD_LEVELS; ++i)
+    {
+        TBMesh coarse;
+        TriMesh* mesh = CreateMesh(i, tolerance, useCache, i == 0 ? finest : coarse);
+        if (!mesh)
+        {
+            delete0(lodNode);
+            return 0;
+        }
+        lodNode->AttachLevel(mesh, minScreenSizes[i]);
+        tolerance *= 5.0f;
+    }
+    return lodNode;
 }
 
-void TBApplication::ComputeNormals (const TBMesh &mesh, std::vector<Vector3f> &flatVertices, std::vector<int> &flatIndices, std::vector<Vector3f> &normals)
+TriMesh* TBApplication::CreateMesh(int level, float tolerance, bool useCache, TBMesh& result)
 {
-    const std::vector<Vector3f>& vertices = mesh.getVertices();
-    const std::vector<int>& indices = mesh.getIndices();
-
-    normals.clear();
-    flatVertices.clear();
-    flatIndices.clear();
-
-    for (int j=0; j<indices.size(); j+=3) {
-        int i1 = indices[j];
-        int i2 = indices[j+1];
-        int i3 = indices[j+2];
-        Vector3f p1 = vertices[i1];
-        Vector3f p2 = vertices[i2];
-        Vector3f p3 = vertices[i3];
-
-        Vector3f cross1 = p2 - p1;
-        Vector3f cross2 = p3 - p1;
-        Vector3f normal = cross1.Cross(cross2);
-        normal.Normalize();
-
-        // Fill in data.
-        flatVertices.push_back(p1);
-        flatVertices.push_back(p2);
-        flatVertices.push_back(p3);
-        flatIndices.push_back(j);
-        flatIndices.push_back(j+1);
-        flatIndices.push_back(j+2);
-        normals.push_back(normal);
-        normals.push_back(normal);
-        normals.push_back(normal);
+    // A cached boolean is mapped and copied in instead of recomputed. Edits
+    // skip the files: the level's model has the stages they reuse.
+    std::string cachePath = useCache ? GetMeshCachePath(tolerance) : std::string();
+    TBMeshFile cache;
+    bool cached = false;
+    if (!cachePath.empty() && cache.open(cachePath.c_str()) == TBMeshFile::STATUS_OK)
+    {
+        // A damaged file is dropped and rebuilt.
+        cached = cache.verify() == TBMeshFile::STATUS_OK;
+        if (cached)
+        {
+            cache.appendTo(result);
+        }
+        cache.close();
+        if (!cached)
+        {
+            remove(cachePath.c_str());
+        }
+    }
+    if (!cached)
+    {
+        TBBoolean::Status status = mRotorModels[level].update(mRotorParams, tolerance, result);
+        if (status != TBBoolean::STATUS_OK)
+        {
+            printf("Boolean failed: %s\n", TBBoolean::getStatusName(status));
+            return 0;
+        }
+        if (!cachePath.empty())
+        {
+            // A cache that cannot be written only costs the next run time.
+            TBMeshFile::save(cachePath.c_str(), result);
+        }
+    }
+
+    return CreateTriMesh(result);
+}
+
+std::string TBApplication::GetMeshCachePath(float tolerance) const
+{
+    if (mMeshCacheDirectory.empty())
+    {
+        return std::string();
     }
+    std::string params = mRotorParams.toText();
+    uint32_t versions[2] = { TBRotor::GENERATOR_VERSION, TBMeshFile::VERSION };
+    uint64_t key = TBMeshFile::computeChecksum(versions, sizeof(versions));
+    key = TBMeshFile::computeChecksum(params.data(), params.size(), key);
+    key = TBMeshFile::computeChecksum(&tolerance, sizeof(tolerance), key);
+    char name[32];
+    sprintf(name, "rotor-%016llx.tbm", (unsigned long long)key);
+    return mMeshCacheDirectory + name;
 }
 
 //----------------------------------------------------------------------------
@@ -3,8 +3,12 @@
 #define TBAPPLICATION_H
 
 #include "Wm5WindowApplication3.h"
-#include "tridcircle.h"
-#include "tbmesh.h"
+#include "tbrotor.h"
+#include "tbrotormodel.h"
+#include "tbmeshfile.h"
+#include "tbmeshexporter.h"
+#include "tblodnode.h"
+#include "tbcacheoptimizer.h"
 
 using namespace Wm5;
 
@@ -25,38 +29,68 @@ public:
 protected:
     void InitializeDataModel();
 
-    Circle3f LinearCircleInterpolate(const Circle3f& circle1,
-                                     const Circle3f& circle2,
-                                     int count, int index);
+    // Applies the rotor edit bound to key, if any, and regenerates the
+    // rotor. Edits that would make the parameters invalid are refused.
+    bool EditRotor(unsigned char key);
+    // Replaces the rotor with one built from mRotorParams. On failure the
+    // rotor is left as it was.
+    bool RegenerateRotor();
+    void SetRotor(Node* rotor);
 
-    void CreateSamples(const Circle3f& circle1,
-                       const Circle3f& circle2,
-                       const Circle3f& circle3,
-                       std::vector<Vector3f>& vertices,
-                       float height);
-
-    // Mesh create methods.
-    void CreateWing(TBMesh &mesh);
-    void CreateBody(TBMesh &mesh);
-    TriMesh* CreateMesh();
+    // Render mesh of the rotor at one level of detail, built within the
+    // given chord tolerance, or 0 if the boolean fails. The welded boolean
+    // result is appended to result. With useCache a saved boolean is mapped
+    // in when there is one, and a new one is saved.
+    TriMesh* CreateMesh(int level, float tolerance, bool useCache, TBMesh& result);
+    // Cache file of the rotor boolean at this tolerance, named after a
+    // hash of everything it depends on, the generator version included.
+    std::string GetMeshCachePath(float tolerance) const;
+    // Level of detail chain of the rotor, regenerated at coarser tolerances,
+    // or 0 if a level fails. The boolean result of the finest level is
+    // appended to finest.
+    Node* CreateLodChain(bool useCache, TBMesh& finest);
     TriMesh* CreateTriMesh(const TBMesh &mesh);
-    void ComputeNormals (const TBMesh &mesh, std::vector<Vector3f>&, std::vector<int>&, std::vector<Vector3f> &normals);
 
     void CreateScene ();
     TriMesh* CreateSphere (const Vector3f& origin, float radius);
 
     // A visual representation of the hull.
-    NodePtr mScene, mTrnNode;
+    NodePtr mScene, mTrnNode, mRotor;
     LightPtr mLight;
     VisualEffectInstancePtr mEffect;
     WireStatePtr mWireState;
     CullStatePtr mCullState;
     Culler mCuller;
 
-    Circle3f mBeginTridCircles[3];
-    Circle3f mEndTridCircles[3];
-    int mInterpoStep;
-    int mHeight;
+    // Rotor geometry; its chord tolerance is the finest level of detail.
+    TBRotorParams mRotorParams;
+    // The rotor before the last edit and its parameters, swapped back in
+    // by undo.
+    NodePtr mUndoRotor;
+    TBRotorParams mUndoRotorParams;
+    // The welded boolean results of the finest level of the rotor and of
+    // the undo rotor, for export.
+    TBMesh* mRotorMesh;
+    TBMesh* mUndoRotorMesh;
+    // Begin circles first, then the end circles.
+    int mSelectedCircle;
+    // Each level of detail keeps its pipeline stages between edits, so an
+    // edit only rebuilds the stages it changes.
+    enum { LOD_LEVELS = 3 };
+    TBRotorModel mRotorModels[LOD_LEVELS];
+    // Boolean results are saved to mesh files in this directory and mapped
+    // back on later runs. Set from $TURBGIZ_MESH_CACHE, which must name an
+    // existing directory; empty, the default, disables the cache.
+    std::string mMeshCacheDirectory;
+    // The 'x' key exports the finest level of detail here.
+    std::string mExportPath;
+    // Edges folding sharper than this, in radians, are shaded flat.
+    float mCreaseAngle;
+    // Reorder the render buffers for the vertex caches. Each optimized
+    // TriMesh adds its report, so the LOD chain leaves one per level; the
+    // scene prints those of the first chain.
+    bool mOptimizeIndices;
+    std::vector<TBCacheReport> mCacheReports;
 };
 
 WM5_REGISTER_INITIALIZE(TBApplication);
@@ -0,0 +1,174 @@
+// Headless rotor generator: reads the rotor parameters from a file, runs the
+// geometry pipeline and writes the mesh as STL, PLY, OBJ or a binary mesh
+// file, after the output's extension. It links no renderer, window system
+// or GL library. In sweep mode it builds every rotor of one or more sweep
+// files, on all cores, and prints a tab separated line for each as it ends.
+//
+//   TurbGizBatch <parameter file> <output.stl|.ply|.obj|.tbm>
+//   TurbGizBatch --sweep [--threads <n>] [--no-isolation] [--timeout <seconds>]
+//                [--export <directory> <.stl|.ply|.obj|.tbm>] <sweep file>...
+
+#include "tbrotor.h"
+#include "tbmeshfile.h"
+#include "tbmeshexporter.h"
+#include "tbsweep.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+
+int usage(const char *program)
+{
+	fprintf(stderr, "usage: %s <parameter file> <output.stl|.ply|.obj|.tbm>\n"
+			"       %s --sweep [--threads <n>] [--no-isolation] [--timeout <seconds>]\n"
+			"              [--export <directory> <.stl|.ply|.obj|.tbm>] <sweep file>...\n",
+			program, program);
+	return 1;
+}
+
+const char *getOutcomeName(const TBSweepResult &result)
+{
+	switch (result.outcome) {
+	case TBSweepResult::OUTCOME_OK:
+		return "ok";
+	case TBSweepResult::OUTCOME_INVALID:
+		return "invalid";
+	case TBSweepResult::OUTCOME_BOOLEAN_FAILED:
+		return TBBoolean::getStatusName(result.booleanStatus);
+	case TBSweepResult::OUTCOME_EXPORT_FAILED:
+		return "export failed";
+	case TBSweepResult::OUTCOME_CRASHED:
+		return result.signal ? strsignal(result.signal) : "crashed";
+	case TBSweepResult::OUTCOME_TIMEOUT:
+		return "timed out";
+	}
+	return "unknown";
+}
+
+// Exit codes: 1 for bad arguments or sweep files, 2 if any job failed.
+int runSweep(int argc, char **argv)
+{
+	int numThreads = -1;
+	bool isolate = true;
+	double timeout = -1.0;
+	std::string exportDirectory, exportExtension;
+	int arg = 2;
+	for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+		if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc) {
+			numThreads = atoi(argv[++arg]);
+		} else if (strcmp(argv[arg], "--no-isolation") == 0) {
+			isolate = false;
+		} else if (strcmp(argv[arg], "--timeout") == 0 && arg + 1 < argc) {
+			timeout = atof(argv[++arg]);
+		} else if (strcmp(argv[arg], "--export") == 0 && arg + 2 < argc) {
+			exportDirectory = argv[++arg];
+			exportExtension = argv[++arg];
+		} else {
+			return usage(argv[0]);
+		}
+	}
+	if (arg == argc) {
+		return usage(argv[0]);
+	}
+
+	std::vector<TBSweepJob> jobs;
+	for (; arg < argc; arg++) {
+		std::string error;
+		if (!TBSweep::load(argv[arg], jobs, &error)) {
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+	}
+	if (!exportDirectory.empty()) {
+		for (size_t i=0; i<jobs.size(); i++) {
+			char name[32];
+			snprintf(name, sizeof(name), "/rotor-%05d", (int)i);
+			jobs[i].exportPath = exportDirectory + name + exportExtension;
+		}
+	}
+
+	TBSweep sweep(numThreads);
+	sweep.setIsolation(isolate);
+	if (timeout >= 0.0) {
+		sweep.setTimeout(timeout);
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	printf("job\tname\toutcome\tvertices\ttriangles\tarea\tvolume\tbuild_ms\ttotal_ms\tworker\n");
+	int numFailed = sweep.run(jobs, [](const TBSweepJob &job, const TBSweepResult &result) {
+		printf("%d\t%s\t%s\t%d\t%d\t%.6g\t%.6g\t%.3f\t%.3f\t%d\n", result.job, job.name.c_str(),
+			   getOutcomeName(result), result.numVertices, result.numTriangles, result.area,
+			   result.volume, result.buildSeconds * 1e3, result.totalSeconds * 1e3, result.worker);
+		fflush(stdout);
+		if (result.outcome == TBSweepResult::OUTCOME_INVALID) {
+			if (job.error.empty()) {
+				fprintf(stderr, "%s: %s\n", job.name.c_str(), job.params.check().c_str());
+			} else {
+				fprintf(stderr, "%s\n", job.error.c_str());
+			}
+		}
+	});
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	fprintf(stderr, "%d jobs, %d failed, in %.3f s\n", (int)jobs.size(), numFailed, seconds);
+	return numFailed ? 2 : 0;
+}
+
+int run(int argc, char **argv)
+{
+	if (argc >= 2 && strcmp(argv[1], "--sweep") == 0) {
+		return runSweep(argc, argv);
+	}
+	if (argc != 3) {
+		return usage(argv[0]);
+	}
+
+	TBRotorParams params;
+	std::string error;
+	if (!params.load(argv[1], &error)) {
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	TBMesh mesh;
+	TBBoolean::Status status = TBRotor(params).createMesh(mesh, params.chordTolerance);
+	if (status != TBBoolean::STATUS_OK) {
+		fprintf(stderr, "%s: boolean failed: %s\n", argv[1], TBBoolean::getStatusName(status));
+		return 2;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t length = strlen(argv[2]);
+	if (length >= 4 && strcmp(argv[2] + length - 4, ".tbm") == 0) {
+		TBMeshFile::Status saved = TBMeshFile::save(argv[2], mesh);
+		if (saved != TBMeshFile::STATUS_OK) {
+			fprintf(stderr, "%s: %s\n", argv[2], TBMeshFile::getStatusName(saved));
+			return 3;
+		}
+	} else {
+		TBMeshExporter::Status saved = TBMeshExporter::save(argv[2], mesh);
+		if (saved != TBMeshExporter::STATUS_OK) {
+			fprintf(stderr, "%s: %s\n", argv[2], TBMeshExporter::getStatusName(saved));
+			return 3;
+		}
+	}
+	printf("%s: %d vertices, %d triangles in %.3f s\n", argv[2],
+		   (int)mesh.getVertices().size(), (int)mesh.getIndices().size() / 3, seconds);
+	return 0;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+#ifdef WM5_USE_MEMORY
+	Memory::Initialize();
+#endif
+	int result = run(argc, argv);
+#ifdef WM5_USE_MEMORY
+	Memory::Terminate("MemoryReport.txt");
+#endif
+	return result;
+}
@@ -0,0 +1,319 @@
+#include "tbbvh.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace {
+
+const int LEAF_SIZE = 4;
+
+template <class T>
+struct CentroidLess
+{
+	int axis;
+
+	bool operator()(const T &a, const T &b) const
+	{
+		return a.position[axis] < b.position[axis];
+	}
+};
+
+}
+
+TBBox::TBBox()
+{
+	for (int k=0; k<3; k++) {
+		min[k] = DBL_MAX;
+		max[k] = -DBL_MAX;
+	}
+}
+
+void TBBox::include(const double point[3])
+{
+	for (int k=0; k<3; k++) {
+		if (point[k] < min[k]) min[k] = point[k];
+		if (point[k] > max[k]) max[k] = point[k];
+	}
+}
+
+void TBBox::include(const TBBox &box)
+{
+	for (int k=0; k<3; k++) {
+		if (box.min[k] < min[k]) min[k] = box.min[k];
+		if (box.max[k] > max[k]) max[k] = box.max[k];
+	}
+}
+
+bool TBBox::overlaps(const TBBox &box) const
+{
+	for (int k=0; k<3; k++) {
+		if (box.min[k] > max[k] || box.max[k] < min[k]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TBBox::isEmpty() const
+{
+	return min[0] > max[0];
+}
+
+TBBvh::TBBvh()
+{
+
+}
+
+TBBvh::~TBBvh()
+{
+
+}
+
+void TBBvh::clear()
+{
+	mNodes.clear();
+	mOrder.clear();
+	mBoxes.clear();
+}
+
+int TBBvh::size() const
+{
+	return mBoxes.size();
+}
+
+bool TBBvh::isEmpty() const
+{
+	return mNodes.empty();
+}
+
+const TBBox &TBBvh::getBounds() const
+{
+	return mNodes.empty() ? mEmpty : mNodes[0].box;
+}
+
+void TBBvh::build(const std::vector<TBBox> &boxes)
+{
+	clear();
+	int numBoxes = boxes.size();
+	if (numBoxes == 0) {
+		return;
+	}
+
+	mBoxes = boxes;
+	std::vector<Centroid> centroids(numBoxes);
+	for (int i=0; i<numBoxes; i++) {
+		centroids[i].primitive = i;
+		for (int k=0; k<3; k++) {
+			centroids[i].position[k] = 0.5 * (boxes[i].min[k] + boxes[i].max[k]);
+		}
+	}
+
+	mNodes.reserve(4 * (numBoxes / LEAF_SIZE + 1));
+	mNodes.push_back(Node());
+	buildNode(0, 0, numBoxes, centroids);
+
+	mOrder.resize(numBoxes);
+	for (int i=0; i<numBoxes; i++) {
+		mOrder[i] = centroids[i].primitive;
+	}
+}
+
+void TBBvh::buildNode(int nodeIndex, int begin, int end,
+					  std::vector<Centroid> &centroids)
+{
+	if (end - begin <= LEAF_SIZE) {
+		TBBox box;
+		for (int i=begin; i<end; i++) {
+			box.include(mBoxes[centroids[i].primitive]);
+		}
+		mNodes[nodeIndex].box = box;
+		mNodes[nodeIndex].first = begin;
+		mNodes[nodeIndex].count = end - begin;
+		return;
+	}
+
+	TBBox centroidBox;
+	for (int i=begin; i<end; i++) {
+		centroidBox.include(centroids[i].position);
+	}
+	int axis = 0;
+	for (int k=1; k<3; k++) {
+		if (centroidBox.max[k] - centroidBox.min[k] >
+			centroidBox.max[axis] - centroidBox.min[axis]) {
+			axis = k;
+		}
+	}
+
+	int middle = (begin + end) / 2;
+	CentroidLess<Centroid> less;
+	less.axis = axis;
+	std::nth_element(centroids.begin() + begin, centroids.begin() + middle,
+					 centroids.begin() + end, less);
+
+	// Children are stored next to each other, so the right one is left + 1.
+	int left = mNodes.size();
+	mNodes[nodeIndex].first = left;
+	mNodes[nodeIndex].count = 0;
+	mNodes.push_back(Node());
+	mNodes.push_back(Node());
+	buildNode(left, begin, middle, centroids);
+	buildNode(left + 1, middle, end, centroids);
+
+	// Inner boxes are merged from the children instead of rescanning the
+	// primitives at every level.
+	TBBox box = mNodes[left].box;
+	box.include(mNodes[left + 1].box);
+	mNodes[nodeIndex].box = box;
+}
+
+void TBBvh::query(const TBBox &box, std::vector<int> &result) const
+{
+	if (mNodes.empty()) {
+		return;
+	}
+
+	std::vector<int> stack;
+	stack.push_back(0);
+	while (!stack.empty()) {
+		const Node &node = mNodes[stack.back()];
+		stack.pop_back();
+		if (!node.box.overlaps(box)) {
+			continue;
+		}
+		if (node.count == 0) {
+			stack.push_back(node.first);
+			stack.push_back(node.first + 1);
+			continue;
+		}
+		for (int i=node.first; i<node.first + node.count; i++) {
+			if (mBoxes[mOrder[i]].overlaps(box)) {
+				result.push_back(mOrder[i]);
+			}
+		}
+	}
+}
+
+bool TBBvh::hitsBox(const TBBox &box, const double origin[3],
+					const double inverse[3]) const
+{
+	double t0 = 0.0;
+	double t1 = DBL_MAX;
+	for (int k=0; k<3; k++) {
+		double a = (box.min[k] - origin[k]) * inverse[k];
+		double b = (box.max[k] - origin[k]) * inverse[k];
+		if (a > b) {
+			std::swap(a, b);
+		}
+		// NaN from 0 * inf compares false and leaves the interval alone.
+		if (a > t0) t0 = a;
+		if (b < t1) t1 = b;
+		if (t0 > t1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void TBBvh::queryRay(const double origin[3], const double direction[3],
+					 std::vector<int> &result) const
+{
+	if (mNodes.empty()) {
+		return;
+	}
+
+	double inverse[3];
+	for (int k=0; k<3; k++) {
+		inverse[k] = 1.0 / direction[k];
+	}
+
+	std::vector<int> stack;
+	stack.push_back(0);
+	while (!stack.empty()) {
+		const Node &node = mNodes[stack.back()];
+		stack.pop_back();
+		if (!hitsBox(node.box, origin, inverse)) {
+			continue;
+		}
+		if (node.count == 0) {
+			stack.push_back(node.first);
+			stack.push_back(node.first + 1);
+			continue;
+		}
+		for (int i=node.first; i<node.first + node.count; i++) {
+			if (hitsBox(mBoxes[mOrder[i]], origin, inverse)) {
+				result.push_back(mOrder[i]);
+			}
+		}
+	}
+}
+
+void TBBvh::queryPairs(const TBBvh &other, std::vector<int> &pairs) const
+{
+	if (mNodes.empty() || other.mNodes.empty()) {
+		return;
+	}
+
+	bool self = this == &other;
+	std::vector<int> stack;
+	stack.push_back(0);
+	stack.push_back(0);
+	while (!stack.empty()) {
+		int b = stack.back();
+		stack.pop_back();
+		int a = stack.back();
+		stack.pop_back();
+
+		const Node &nodeA = mNodes[a];
+		const Node &nodeB = other.mNodes[b];
+		if (!nodeA.box.overlaps(nodeB.box)) {
+			continue;
+		}
+
+		if (self && a == b) {
+			// Within one subtree only the unordered pairs are needed.
+			if (nodeA.count > 0) {
+				for (int i=nodeA.first; i<nodeA.first + nodeA.count; i++) {
+					for (int j=i+1; j<nodeA.first + nodeA.count; j++) {
+						if (mBoxes[mOrder[i]].overlaps(mBoxes[mOrder[j]])) {
+							pairs.push_back(mOrder[i]);
+							pairs.push_back(mOrder[j]);
+						}
+					}
+				}
+				continue;
+			}
+			int left = nodeA.first;
+			int children[6] = { left, left, left, left + 1, left + 1, left + 1 };
+			for (int c=0; c<6; c++) {
+				stack.push_back(children[c]);
+			}
+			continue;
+		}
+
+		if (nodeA.count > 0 && nodeB.count > 0) {
+			for (int i=nodeA.first; i<nodeA.first + nodeA.count; i++) {
+				const TBBox &boxA = mBoxes[mOrder[i]];
+				for (int j=nodeB.first; j<nodeB.first + nodeB.count; j++) {
+					if (boxA.overlaps(other.mBoxes[other.mOrder[j]])) {
+						pairs.push_back(mOrder[i]);
+						pairs.push_back(other.mOrder[j]);
+					}
+				}
+			}
+			continue;
+		}
+
+		// Descend into the inner node with the larger box.
+		bool splitA = nodeB.count > 0 ||
+			(nodeA.count == 0 && volume(nodeA.box) >= volume(nodeB.box));
+		for (int c=0; c<2; c++) {
+			stack.push_back(splitA ? nodeA.first + c : a);
+			stack.push_back(splitA ? b : nodeB.first + c);
+		}
+	}
+}
+
+double TBBvh::volume(const TBBox &box)
+{
+	return (box.max[0] - box.min[0]) * (box.max[1] - box.min[1]) *
+		(box.max[2] - box.min[2]);
+}
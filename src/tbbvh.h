@@ -0,0 +1,82 @@
+#ifndef TBBVH_H
+#define TBBVH_H
+
+#include <vector>
+
+// Axis-aligned box in double precision.
+struct TBBox
+{
+	double min[3];
+	double max[3];
+
+	TBBox();
+	void include(const double point[3]);
+	void include(const TBBox &box);
+	bool overlaps(const TBBox &box) const;
+	bool isEmpty() const;
+};
+
+// Bounding volume hierarchy over a set of boxes, usually one per triangle.
+//
+// The tree is stored in a flat node array built top down by splitting the
+// primitive centroids at the median of the widest axis. Queries report the
+// primitive indices whose boxes pass the test; exact geometric tests are
+// left to the caller.
+class TBBvh
+{
+	public:
+		TBBvh();
+		~TBBvh();
+
+		void build(const std::vector<TBBox> &boxes);
+		void clear();
+		int size() const;
+		bool isEmpty() const;
+		const TBBox &getBounds() const;
+
+		// Primitives whose boxes overlap box.
+		void query(const TBBox &box, std::vector<int> &result) const;
+
+		// Primitives whose boxes are hit by the ray origin + t * direction,
+		// t >= 0.
+		void queryRay(const double origin[3], const double direction[3],
+					  std::vector<int> &result) const;
+
+		// Pairs (a, b) of primitives, a from this tree and b from other,
+		// whose boxes overlap. The pairs are appended as a0 b0 a1 b1 ...
+		// When other is this tree, each unordered pair of distinct
+		// primitives is reported once.
+		void queryPairs(const TBBvh &other, std::vector<int> &pairs) const;
+
+	private:
+		struct Node
+		{
+			TBBox box;
+			// Leaves: first primitive in mOrder and count. Inner nodes:
+			// index of the left child, the right one follows it, and 0.
+			int first;
+			int count;
+		};
+
+		// Primitive centroid, partitioned in place while building so the
+		// median split does not chase indices.
+		struct Centroid
+		{
+			double position[3];
+			int primitive;
+		};
+
+		void buildNode(int nodeIndex, int begin, int end,
+					   std::vector<Centroid> &centroids);
+		bool hitsBox(const TBBox &box, const double origin[3],
+					 const double inverse[3]) const;
+		static double volume(const TBBox &box);
+
+	private:
+		std::vector<Node> mNodes;
+		std::vector<int> mOrder;
+		std::vector<TBBox> mBoxes;
+		TBBox mEmpty;
+};
+
+#endif
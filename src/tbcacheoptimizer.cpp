@@ -0,0 +1,228 @@
+#include "tbcacheoptimizer.h"
+#include <cmath>
+
+namespace {
+
+// Size of the LRU cache simulated while scoring, and the score tables of
+// Forsyth's method.
+const int CACHE_SIZE = 32;
+const int MAX_VALENCE = 32;
+
+struct ScoreTable
+{
+	float cache[CACHE_SIZE];
+	float valence[MAX_VALENCE + 1];
+
+	ScoreTable()
+	{
+		// The three vertices of the last triangle score the same, so the
+		// next triangle does not favour any of its edges.
+		for (int i=0; i<CACHE_SIZE; i++) {
+			if (i < 3) {
+				cache[i] = 0.75f;
+			} else {
+				float scale = 1.0f / (CACHE_SIZE - 3);
+				cache[i] = powf(1.0f - (i - 3) * scale, 1.5f);
+			}
+		}
+		// Vertices with few triangles left are boosted, so they are finished
+		// off instead of being left as isolated triangles.
+		valence[0] = 0.0f;
+		for (int i=1; i<=MAX_VALENCE; i++) {
+			valence[i] = 2.0f / sqrtf((float)i);
+		}
+	}
+
+	float score(int cachePosition, int numActive) const
+	{
+		if (numActive == 0) {
+			return -1.0f;
+		}
+		float value = cachePosition < 0 ? 0.0f : cache[cachePosition];
+		return value + valence[numActive < MAX_VALENCE ? numActive : MAX_VALENCE];
+	}
+};
+
+}
+
+float TBCacheOptimizer::computeAcmr(const int *indices, int numIndices, int cacheSize)
+{
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0) {
+		return 0.0f;
+	}
+
+	int numVertices = 0;
+	for (int i=0; i<numTriangles*3; i++) {
+		if (indices[i] >= numVertices) {
+			numVertices = indices[i] + 1;
+		}
+	}
+
+	// A vertex is in the FIFO while fewer than cacheSize misses happened
+	// since it was loaded.
+	std::vector<int> loadedAt(numVertices, -1);
+	int misses = 0;
+	for (int i=0; i<numTriangles*3; i++) {
+		int vertex = indices[i];
+		if (loadedAt[vertex] < 0 || misses - loadedAt[vertex] >= cacheSize) {
+			loadedAt[vertex] = misses;
+			misses++;
+		}
+	}
+	return (float)misses / numTriangles;
+}
+
+void TBCacheOptimizer::optimizeTriangles(int *indices, int numIndices, int numVertices)
+{
+	int numTriangles = numIndices / 3;
+	if (numTriangles == 0) {
+		return;
+	}
+	static const ScoreTable table;
+
+	// Triangles of every vertex; the first numActive of each list are the
+	// ones not emitted yet.
+	std::vector<int> offsets(numVertices + 1, 0);
+	for (int i=0; i<numTriangles*3; i++) {
+		offsets[indices[i] + 1]++;
+	}
+	for (int v=0; v<numVertices; v++) {
+		offsets[v + 1] += offsets[v];
+	}
+	std::vector<int> vertexTriangles(numTriangles * 3);
+	std::vector<int> numActive(numVertices, 0);
+	for (int i=0; i<numTriangles*3; i++) {
+		int v = indices[i];
+		vertexTriangles[offsets[v] + numActive[v]++] = i / 3;
+	}
+
+	std::vector<int> cachePosition(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	for (int v=0; v<numVertices; v++) {
+		vertexScores[v] = table.score(-1, numActive[v]);
+	}
+	std::vector<float> triangleScores(numTriangles);
+	for (int t=0; t<numTriangles; t++) {
+		triangleScores[t] = vertexScores[indices[t*3]] + vertexScores[indices[t*3 + 1]]
+			+ vertexScores[indices[t*3 + 2]];
+	}
+
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<int> output;
+	output.reserve(numTriangles * 3);
+
+	// Room for the new triangle's vertices on top of the full cache.
+	int cache[CACHE_SIZE + 3];
+	int cacheCount = 0;
+	int scanCursor = 0;
+
+	int best = -1;
+	while ((int)output.size() < numTriangles * 3) {
+		if (best < 0) {
+			// Nothing in the cache has triangles left: restart from the best
+			// of the remaining triangles, looked for from a moving cursor so
+			// the whole search stays linear.
+			while (emitted[scanCursor]) {
+				scanCursor++;
+			}
+			best = scanCursor;
+			for (int t=scanCursor; t<numTriangles && t<scanCursor + 64; t++) {
+				if (!emitted[t] && triangleScores[t] > triangleScores[best]) {
+					best = t;
+				}
+			}
+		}
+
+		emitted[best] = true;
+		int corners[3] = { indices[best*3], indices[best*3 + 1], indices[best*3 + 2] };
+
+		// Move the triangle's vertices to the front of the cache and drop the
+		// triangle from their active lists.
+		int newCache[CACHE_SIZE + 3];
+		int newCount = 0;
+		for (int k=0; k<3; k++) {
+			int v = corners[k];
+			output.push_back(v);
+			newCache[newCount++] = v;
+
+			int begin = offsets[v];
+			int end = begin + numActive[v];
+			for (int j=begin; j<end; j++) {
+				if (vertexTriangles[j] == best) {
+					vertexTriangles[j] = vertexTriangles[end - 1];
+					vertexTriangles[end - 1] = best;
+					break;
+				}
+			}
+			numActive[v]--;
+		}
+		for (int i=0; i<cacheCount; i++) {
+			int v = cache[i];
+			if (v != corners[0] && v != corners[1] && v != corners[2]) {
+				newCache[newCount++] = v;
+			}
+		}
+
+		// Rescore the vertices that were or are in the cache, then the
+		// triangles around them, keeping the best one for the next step.
+		for (int i=0; i<newCount; i++) {
+			int v = newCache[i];
+			cachePosition[v] = i < CACHE_SIZE ? i : -1;
+			vertexScores[v] = table.score(cachePosition[v], numActive[v]);
+		}
+		best = -1;
+		for (int i=0; i<newCount; i++) {
+			int v = newCache[i];
+			for (int j=offsets[v]; j<offsets[v] + numActive[v]; j++) {
+				int t = vertexTriangles[j];
+				triangleScores[t] = vertexScores[indices[t*3]] + vertexScores[indices[t*3 + 1]]
+					+ vertexScores[indices[t*3 + 2]];
+				if (best < 0 || triangleScores[t] > triangleScores[best]) {
+					best = t;
+				}
+			}
+		}
+
+		cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+		for (int i=0; i<cacheCount; i++) {
+			cache[i] = newCache[i];
+		}
+	}
+
+	for (int i=0; i<numTriangles*3; i++) {
+		indices[i] = output[i];
+	}
+}
+
+void TBCacheOptimizer::optimizeVertices(int *indices, int numIndices, int numVertices,
+										std::vector<int> &order)
+{
+	std::vector<int> remap(numVertices, -1);
+	order.clear();
+	order.reserve(numVertices);
+	for (int i=0; i<numIndices; i++) {
+		int &index = indices[i];
+		if (remap[index] < 0) {
+			remap[index] = order.size();
+			order.push_back(index);
+		}
+		index = remap[index];
+	}
+	for (int v=0; v<numVertices; v++) {
+		if (remap[v] < 0) {
+			order.push_back(v);
+		}
+	}
+}
+
+TBCacheReport TBCacheOptimizer::optimize(int *indices, int numIndices, int numVertices,
+										 std::vector<int> &order)
+{
+	TBCacheReport report;
+	report.acmrBefore = computeAcmr(indices, numIndices);
+	optimizeTriangles(indices, numIndices, numVertices);
+	optimizeVertices(indices, numIndices, numVertices, order);
+	report.acmrAfter = computeAcmr(indices, numIndices);
+	return report;
+}
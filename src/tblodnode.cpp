@@ -0,0 +1,68 @@
+#include "tblodnode.h"
+
+//----------------------------------------------------------------------------
+TBLodNode::TBLodNode ()
+{
+}
+//----------------------------------------------------------------------------
+TBLodNode::~TBLodNode ()
+{
+}
+//----------------------------------------------------------------------------
+int TBLodNode::AttachLevel (Spatial* level, float minScreenSize)
+{
+    int index = AttachChild(level);
+    if ((int)mMinScreenSizes.size() <= index)
+    {
+        mMinScreenSizes.resize(index + 1, 0.0f);
+    }
+    mMinScreenSizes[index] = minScreenSize;
+    return index;
+}
+//----------------------------------------------------------------------------
+float TBLodNode::GetScreenSize (const Camera* camera) const
+{
+    float radius = WorldBound.GetRadius();
+    if (!camera->IsPerspective())
+    {
+        return radius / camera->GetUMax();
+    }
+
+    // The view frustum spans 2*uMax/dMin per unit of depth.
+    AVector diff = WorldBound.GetCenter() - camera->GetPosition();
+    float distance = diff.Length();
+    if (distance <= radius)
+    {
+        return Mathf::MAX_REAL;
+    }
+    return radius * camera->GetDMin() / (distance * camera->GetUMax());
+}
+//----------------------------------------------------------------------------
+void TBLodNode::SelectLevelOfDetail (const Camera* camera)
+{
+    int numLevels = (int)mMinScreenSizes.size();
+    if (numLevels == 0)
+    {
+        SetActiveChild(SN_INVALID_CHILD);
+        return;
+    }
+
+    float screenSize = GetScreenSize(camera);
+    int level = numLevels - 1;
+    for (int i = 0; i < numLevels - 1; ++i)
+    {
+        if (screenSize >= mMinScreenSizes[i])
+        {
+            level = i;
+            break;
+        }
+    }
+    SetActiveChild(level);
+}
+//----------------------------------------------------------------------------
+void TBLodNode::GetVisibleSet (Culler& culler, bool noCull)
+{
+    SelectLevelOfDetail(culler.GetCamera());
+    SwitchNode::GetVisibleSet(culler, noCull);
+}
+//----------------------------------------------------------------------------
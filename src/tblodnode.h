@@ -0,0 +1,37 @@
+#ifndef TBLODNODE_H
+#define TBLODNODE_H
+
+#include "Wm5SwitchNode.h"
+#include "Wm5Culler.h"
+#include <vector>
+
+using namespace Wm5;
+
+// Switch node whose active child is picked from the projected size of its
+// world bound every time the visible set is computed.
+//
+// The screen size is the bound's diameter as a fraction of the viewport
+// height. Levels are attached from the finest to the coarsest, each with the
+// smallest screen size it is used for; the first level whose threshold is
+// met is drawn, and the last one when none is.
+class TBLodNode : public SwitchNode
+{
+public:
+    TBLodNode ();
+    virtual ~TBLodNode ();
+
+    // Returns the child index of the level.
+    int AttachLevel (Spatial* level, float minScreenSize);
+
+    float GetScreenSize (const Camera* camera) const;
+
+protected:
+    void SelectLevelOfDetail (const Camera* camera);
+
+    // Culling support.
+    virtual void GetVisibleSet (Culler& culler, bool noCull);
+
+    std::vector<float> mMinScreenSizes;
+};
+
+#endif
@@ -1,11 +1,122 @@
-
 #include "tbmesh.h"
 #include "Wm5APoint.h"
-#include "Wm5MeshSmoother.h"
+#include "tbthreadpool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Normal of a closed polygon by Newell's method; its length is twice the
+// area, so it is also valid for non-convex outlines.
+Vector3f polygonNormal(const std::vector<Vector3f> &ring)
+{
+	Vector3f normal = Vector3f::ZERO;
+	int count = ring.size();
+	for (int i=0; i<count; i++) {
+		const Vector3f &p = ring[i];
+		const Vector3f &q = ring[(i + 1) % count];
+		normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+		normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+		normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+	}
+	return normal;
+}
+
+Vector3f polygonCentroid(const std::vector<Vector3f> &ring)
+{
+	Vector3f sum = Vector3f::ZERO;
+	for (int i=0; i<(int)ring.size(); i++) {
+		sum += ring[i];
+	}
+	return ring.empty() ? sum : sum / (float)ring.size();
+}
+
+double cross2(const double *a, const double *b, const double *c)
+{
+	return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+// Ear clipping of a ring projected along its normal. Triangles are
+// counter clockwise around the normal and use indices relative to the ring.
+void triangulateRing(const std::vector<Vector3f> &ring, const Vector3f &normal,
+					 std::vector<int> &triangles)
+{
+	// Drop the dominant axis of the normal, keeping the 2D winding the same
+	// as the winding around the normal.
+	int axis = 0;
+	for (int k=1; k<3; k++) {
+		if (fabs(normal[k]) > fabs(normal[axis])) {
+			axis = k;
+		}
+	}
+	int u = (axis + 1) % 3;
+	int v = (axis + 2) % 3;
+	if (normal[axis] < 0.0f) {
+		std::swap(u, v);
+	}
+
+	int count = ring.size();
+	std::vector<double> points(count * 2);
+	for (int i=0; i<count; i++) {
+		points[i*2] = ring[i][u];
+		points[i*2 + 1] = ring[i][v];
+	}
+
+	std::vector<int> polygon(count);
+	for (int i=0; i<count; i++) {
+		polygon[i] = i;
+	}
+
+	// Each pass around the polygon clips at least one ear unless the outline
+	// is degenerate; then the rest is closed as a fan.
+	int misses = 0;
+	int i = 0;
+	while (polygon.size() > 3 && misses < (int)polygon.size()) {
+		int n = polygon.size();
+		int prev = polygon[(i + n - 1) % n];
+		int curr = polygon[i % n];
+		int next = polygon[(i + 1) % n];
+		const double *a = &points[prev*2];
+		const double *b = &points[curr*2];
+		const double *c = &points[next*2];
+
+		bool isEar = cross2(a, b, c) > 0.0;
+		for (int k=0; isEar && k<n; k++) {
+			int other = polygon[k];
+			if (other == prev || other == curr || other == next) {
+				continue;
+			}
+			const double *p = &points[other*2];
+			isEar = !(cross2(a, b, p) >= 0.0 && cross2(b, c, p) >= 0.0 && cross2(c, a, p) >= 0.0);
+		}
+
+		if (!isEar) {
+			i = (i + 1) % n;
+			misses++;
+			continue;
+		}
+		triangles.push_back(prev);
+		triangles.push_back(curr);
+		triangles.push_back(next);
+		polygon.erase(polygon.begin() + i % n);
+		i = i % (n - 1);
+		misses = 0;
+	}
+	for (int k=1; k+1<(int)polygon.size(); k++) {
+		triangles.push_back(polygon[0]);
+		triangles.push_back(polygon[k]);
+		triangles.push_back(polygon[k + 1]);
+	}
+}
+
+}
 
 TBMesh::TBMesh()
 {
 	mVerticeNum = 0;
+	mWeldedNum = 0;
+	mHasQueuedTransform = false;
+	mGeometry = std::make_shared<Geometry>();
 }
 
 TBMesh::~TBMesh()
@@ -17,101 +128,474 @@ TBMesh *TBMesh::clone() const
 {
 	TBMesh *mesh = new0 TBMesh();
 	mesh->mVerticeNum = mVerticeNum;
-	mesh->mVertices.insert(mesh->mVertices.end(), mVertices.begin(), mVertices.end());
-	mesh->mIndices.insert(mesh->mIndices.end(), mIndices.begin(), mIndices.end());
-
-	std::map<std::string, int>::const_iterator it = mIndexedVertices.begin();
-	for (; it != mIndexedVertices.end(); it++) {
-		mesh->mIndexedVertices[it->first] = it->second;
-	}
+	mesh->mGeometry = mGeometry;
+	mesh->mWeldIndex.setTolerance(mWeldIndex.getTolerance());
+	mesh->mHasQueuedTransform = mHasQueuedTransform;
+	mesh->mQueuedTransform = mQueuedTransform;
+	mesh->mAdjacency = mAdjacency;
 	return mesh;
 }
 
-std::string TBMesh::hashVertex(const Vector3f vertex)
+void TBMesh::makeUnique()
 {
-	int x = int (vertex.X() * 10000);
-	int y = int (vertex.Y() * 10000);
-	int z = int (vertex.Z() * 10000);
+	// Copy on write: bake the per-instance transform and take a private copy
+	// of storage that is shared with clones.
+	if (mHasQueuedTransform) {
+		applyTransforms();
+	} else if (mGeometry.use_count() > 1) {
+		mGeometry = std::make_shared<Geometry>(*mGeometry);
+	}
+}
 
-	std::string hash;
-	char stemp[100] = "";
-	snprintf(stemp, 100, "%d-", x);
-	hash += std::string(stemp);
-	snprintf(stemp, 100, "%d-", y);
-	hash += std::string(stemp);
-	snprintf(stemp, 100, "%d", z);
-	hash += std::string(stemp);
+void TBMesh::setWeldTolerance(float tolerance)
+{
+	mWeldIndex.setTolerance(tolerance);
+	mWeldedNum = 0;
+}
 
-	return hash;
+float TBMesh::getWeldTolerance() const
+{
+	return mWeldIndex.getTolerance();
 }
 
 const std::vector<Vector3f>& TBMesh::getVertices() const
 {
-	return mVertices;
+	if (!mHasQueuedTransform) {
+		return mGeometry->vertices;
+	}
+	std::lock_guard<std::mutex> lock(mCacheMutex);
+	if ((int)mTransformedVertices.size() != mVerticeNum) {
+		mTransformedVertices.resize(mVerticeNum);
+		if (mVerticeNum > 0) {
+			mQueuedTransform.apply(&mGeometry->vertices[0], &mTransformedVertices[0], mVerticeNum);
+		}
+	}
+	return mTransformedVertices;
+}
+
+const std::vector<Vector3f>& TBMesh::getLocalVertices() const
+{
+	return mGeometry->vertices;
 }
 
 const std::vector<int>& TBMesh::getIndices() const
 {
-	return mIndices;
+	return mGeometry->indices;
+}
+
+const TBMeshAdjacency& TBMesh::getAdjacency() const
+{
+	std::lock_guard<std::mutex> lock(mCacheMutex);
+	if (!mAdjacency) {
+		const std::vector<int> &indices = mGeometry->indices;
+		mAdjacency = std::make_shared<TBMeshAdjacency>(indices.empty() ? NULL : &indices[0],
+			(int)indices.size(), mVerticeNum);
+	}
+	return *mAdjacency;
+}
+
+const TBAffine& TBMesh::getTransform() const
+{
+	return mQueuedTransform;
+}
+
+void TBMesh::syncWeldIndex()
+{
+	// Vertices appended without welding, or moved by a transform, are
+	// registered lazily the next time a corner has to be welded.
+	if (mWeldedNum == mVerticeNum) {
+		return;
+	}
+	mWeldIndex.reserve(mVerticeNum);
+	std::vector<Vector3f> &vertices = mGeometry->vertices;
+	for (; mWeldedNum < mVerticeNum; mWeldedNum++) {
+		mWeldIndex.insert(vertices[mWeldedNum], mWeldedNum);
+	}
 }
 
 int TBMesh::pushVectex(const Vector3f p)
 {
-	std::string hash = hashVertex(p);
-	std::map<std::string, int>::iterator it = mIndexedVertices.find(hash);
-	if (it == mIndexedVertices.end()) {
-		int index = mVerticeNum;
-		mIndexedVertices[hash] = index;
-		mVertices.push_back(p);
+	makeUnique();
+	syncWeldIndex();
+	std::vector<Vector3f> &vertices = mGeometry->vertices;
+	int index = mVerticeNum > 0 ? mWeldIndex.find(p, &vertices[0]) : -1;
+	if (index < 0) {
+		index = mVerticeNum;
+		mWeldIndex.insert(p, index);
+		vertices.push_back(p);
 		mVerticeNum++;
-		return index;
+		mWeldedNum++;
 	}
-	return it->second;
+	return index;
 }
 
 void TBMesh::addTriangle(const Vector3f p1, const Vector3f p2, const Vector3f p3)
 {
-	mIndices.push_back(pushVectex(p1));
-	mIndices.push_back(pushVectex(p2));
-	mIndices.push_back(pushVectex(p3));
+	int i1 = pushVectex(p1);
+	int i2 = pushVectex(p2);
+	int i3 = pushVectex(p3);
+	mAdjacency.reset();
+	std::vector<int> &indices = mGeometry->indices;
+	indices.push_back(i1);
+	indices.push_back(i2);
+	indices.push_back(i3);
+}
+
+void TBMesh::reserve(int numVertices, int numTriangles)
+{
+	makeUnique();
+	mGeometry->vertices.reserve(numVertices);
+	mGeometry->indices.reserve(numTriangles * 3);
+	mWeldIndex.reserve(numVertices);
+}
+
+void TBMesh::addTriangles(const Vector3f *corners, int numTriangles)
+{
+	reserve(mVerticeNum + numTriangles, (int)mGeometry->indices.size() / 3 + numTriangles);
+	mAdjacency.reset();
+	for (int i=0; i<numTriangles*3; i++) {
+		int index = pushVectex(corners[i]);
+		mGeometry->indices.push_back(index);
+	}
+}
+
+void TBMesh::appendIndexed(const Vector3f *vertices, int numVertices,
+						   const int *indices, int numIndices, bool weld)
+{
+	int numTriangles = numIndices / 3;
+	reserve(mVerticeNum + numVertices, (int)mGeometry->indices.size() / 3 + numTriangles);
+	mAdjacency.reset();
+	std::vector<int> &meshIndices = mGeometry->indices;
+
+	if (!weld) {
+		int offset = mVerticeNum;
+		mGeometry->vertices.insert(mGeometry->vertices.end(), vertices, vertices + numVertices);
+		mVerticeNum += numVertices;
+		for (int i=0; i<numTriangles*3; i++) {
+			meshIndices.push_back(indices[i] + offset);
+		}
+		return;
+	}
+
+	// One weld per referenced vertex instead of one per corner.
+	std::vector<int> remap(numVertices, -1);
+	for (int i=0; i<numTriangles*3; i++) {
+		int index = indices[i];
+		if (remap[index] < 0) {
+			remap[index] = pushVectex(vertices[index]);
+		}
+		meshIndices.push_back(remap[index]);
+	}
+}
+
+void TBMesh::loft(const std::vector<Vector3f> *rings, int numRings,
+				  bool capBegin, bool capEnd)
+{
+	if (numRings <= 0 || rings[0].size() < 3) {
+		return;
+	}
+	int ringSize = rings[0].size();
+	for (int r=1; r<numRings; r++) {
+		assertion((int)rings[r].size() == ringSize, "Lofted rings must have the same size.\n");
+	}
+
+	// The side faces point outwards when the rings wind counter clockwise
+	// around the direction from the first ring to the last one.
+	Vector3f beginNormal = polygonNormal(rings[0]);
+	Vector3f endNormal = polygonNormal(rings[numRings - 1]);
+	bool reversed = false;
+	bool endReversed = false;
+	if (numRings > 1) {
+		Vector3f axis = polygonCentroid(rings[numRings - 1]) - polygonCentroid(rings[0]);
+		reversed = beginNormal.Dot(axis) < 0.0f;
+		endReversed = endNormal.Dot(axis) < 0.0f;
+	}
+
+	// Caps are triangulated per ring, as the end outline may differ from the
+	// first one.
+	std::vector<int> beginTriangles, endTriangles;
+	if (capBegin) {
+		triangulateRing(rings[0], beginNormal, beginTriangles);
+	}
+	if (capEnd) {
+		triangulateRing(rings[numRings - 1], endNormal, endTriangles);
+	}
+
+	int numTriangles = (numRings - 1) * ringSize * 2
+		+ (int)(beginTriangles.size() + endTriangles.size()) / 3;
+	reserve(mVerticeNum + numRings * ringSize, (int)mGeometry->indices.size() / 3 + numTriangles);
+	mAdjacency.reset();
+
+	int offset = mVerticeNum;
+	std::vector<Vector3f> &vertices = mGeometry->vertices;
+	for (int r=0; r<numRings; r++) {
+		vertices.insert(vertices.end(), rings[r].begin(), rings[r].end());
+	}
+	mVerticeNum += numRings * ringSize;
+
+	std::vector<int> &indices = mGeometry->indices;
+	int first = reversed ? 2 : 1;
+	int second = reversed ? 1 : 2;
+	for (int r=0; r+1<numRings; r++) {
+		int lower = offset + r * ringSize;
+		int upper = lower + ringSize;
+		for (int i=0; i<ringSize; i++) {
+			int j = (i + 1) % ringSize;
+			int quad[4] = { lower + i, lower + j, upper + j, upper + i };
+			indices.push_back(quad[0]);
+			indices.push_back(quad[first]);
+			indices.push_back(quad[second]);
+			indices.push_back(quad[0]);
+			indices.push_back(quad[first + 1]);
+			indices.push_back(quad[second + 1]);
+		}
+	}
+
+	// The caps are counter clockwise around the ring normals; the begin cap
+	// faces backwards.
+	for (int t=0; t<(int)beginTriangles.size(); t+=3) {
+		indices.push_back(offset + beginTriangles[t]);
+		indices.push_back(offset + beginTriangles[t + (reversed ? 1 : 2)]);
+		indices.push_back(offset + beginTriangles[t + (reversed ? 2 : 1)]);
+	}
+	int last = offset + (numRings - 1) * ringSize;
+	for (int t=0; t<(int)endTriangles.size(); t+=3) {
+		indices.push_back(last + endTriangles[t]);
+		indices.push_back(last + endTriangles[t + (endReversed ? 2 : 1)]);
+		indices.push_back(last + endTriangles[t + (endReversed ? 1 : 2)]);
+	}
+}
+
+TBMesh& TBMesh::transformBy(const Transform &xform)
+{
+	queueTransform(xform);
+	if (mGeometry.use_count() > 1) {
+		return *this;
+	}
+	return applyTransforms();
+}
+
+TBMesh& TBMesh::queueTransform(const Transform &xform)
+{
+	mQueuedTransform = mQueuedTransform.then(TBAffine(xform));
+	mHasQueuedTransform = true;
+	mTransformedVertices.clear();
+	return *this;
+}
+
+TBMesh& TBMesh::applyTransforms()
+{
+	if (!mHasQueuedTransform) {
+		return *this;
+	}
+
+	if (mGeometry.use_count() > 1) {
+		// Write the transformed copy straight into private storage.
+		std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>();
+		geometry->indices = mGeometry->indices;
+		if (mTransformedVertices.empty()) {
+			getVertices();
+		}
+		geometry->vertices.swap(mTransformedVertices);
+		mGeometry = geometry;
+	} else if (mVerticeNum > 0) {
+		mQueuedTransform.apply(&mGeometry->vertices[0], &mGeometry->vertices[0], mVerticeNum);
+	}
+
+	mQueuedTransform = TBAffine::IDENTITY;
+	mHasQueuedTransform = false;
+	std::vector<Vector3f>().swap(mTransformedVertices);
+	mWeldIndex.clear();
+	mWeldedNum = 0;
+	return *this;
 }
 
-TBMesh& TBMesh::transformBy(Transform xform)
+TBMesh *TBMesh::transformedBy(const Transform &xform) const
 {
-	for (int i=0; i<mVertices.size(); i++) {
-		Vector3f vertex = xform * (APoint)(mVertices.at(i));
-		mVertices.at(i) = vertex;
+	TBMesh *mesh = new0 TBMesh();
+	mesh->mWeldIndex.setTolerance(mWeldIndex.getTolerance());
+	mesh->mVerticeNum = mVerticeNum;
+	mesh->mGeometry->vertices.resize(mVerticeNum);
+	mesh->mGeometry->indices = mGeometry->indices;
+	mesh->mAdjacency = mAdjacency;
+	if (mVerticeNum > 0) {
+		TBAffine affine = mQueuedTransform.then(TBAffine(xform));
+		affine.apply(&mGeometry->vertices[0], &mesh->mGeometry->vertices[0], mVerticeNum);
 	}
-	return const_cast<TBMesh&>(*this);
+	return mesh;
 }
 
-void TBMesh::smooth()
+void TBMesh::smooth(const TBSmoothing &smoothing)
 {
-	int numVertices = mVertices.size();
-	int numIndices = mIndices.size();
-	Vector3f *vertices = new1<Vector3f>(numVertices);
-	int *indices = new1<int>(numIndices);
+	makeUnique();
+
+	std::vector<Vector3f> &vertices = mGeometry->vertices;
+	const std::vector<int> &indices = mGeometry->indices;
+	int numVertices = vertices.size();
+	int numCorners = indices.size() / 3 * 3;
+	if (numVertices == 0 || smoothing.iterations <= 0) {
+		return;
+	}
+
+	const TBMeshAdjacency &adjacency = getAdjacency();
 
-	std::vector<Vector3f>::iterator it = mVertices.begin();
-	for (int i = 0; it != mVertices.end(); it++) {
-		vertices[i] = *it;
-		i++;
+	std::vector<Vector3f> faceNormals;
+	float cosFeature = Mathf::Cos(smoothing.featureAngle);
+	if (smoothing.featureAngle > 0.0f) {
+		faceNormals.resize(numCorners / 3);
+		for (int t=0; t<numCorners/3; t++) {
+			const Vector3f &p0 = vertices[indices[t*3]];
+			Vector3f normal = (vertices[indices[t*3 + 1]] - p0).Cross(vertices[indices[t*3 + 2]] - p0);
+			normal.Normalize();
+			faceNormals[t] = normal;
+		}
 	}
 
-	std::vector<int>::iterator iit = mIndices.begin();
-	for (int i = 0; iit != mIndices.end(); iit++) {
-		indices[i] = *iit;
-		i++;
+	// Pin the ends of boundary and feature edges.
+	std::vector<char> pinned(numVertices, 0);
+	for (int e=0; e<adjacency.getNumEdges(); e++) {
+		int count;
+		const int *corners = adjacency.getEdgeCorners(e, count);
+		bool pin = count == 1 && smoothing.pinBoundary;
+		if (count == 2 && !faceNormals.empty()) {
+			pin = faceNormals[corners[0] / 3].Dot(faceNormals[corners[1] / 3]) < cosFeature;
+		}
+		if (pin) {
+			int lower, upper;
+			adjacency.getEdgeVertices(e, lower, upper);
+			pinned[lower] = 1;
+			pinned[upper] = 1;
+		}
 	}
-	MeshSmootherf smoother(numVertices, vertices, numIndices / 3, indices);
-	smoother.Update();
 
-	for (int i=0; i<numVertices; i++) {
-		mVertices.at(i) = vertices[i];
+	// Jacobi passes: each one reads one buffer and writes the other, so the
+	// blocks are independent.
+	std::vector<Vector3f> buffer(vertices);
+	std::vector<Vector3f> *source = &vertices;
+	std::vector<Vector3f> *target = &buffer;
+	const int blockSize = 4096;
+	int numBlocks = (numVertices + blockSize - 1) / blockSize;
+	TBThreadPool &pool = TBThreadPool::getShared();
+
+	std::vector<float> factors;
+	for (int i=0; i<smoothing.iterations; i++) {
+		factors.push_back(smoothing.lambda);
+		if (smoothing.mu != 0.0f) {
+			factors.push_back(smoothing.mu);
+		}
+	}
+	for (int pass=0; pass<(int)factors.size(); pass++) {
+		float factor = factors[pass];
+		const std::vector<Vector3f> &from = *source;
+		std::vector<Vector3f> &to = *target;
+		pool.parallelFor(numBlocks, [&](int block) {
+			int end = std::min(numVertices, (block + 1) * blockSize);
+			for (int v=block*blockSize; v<end; v++) {
+				int count;
+				const int *neighbors = adjacency.getVertexNeighbors(v, count);
+				if (pinned[v] || count == 0) {
+					to[v] = from[v];
+					continue;
+				}
+				Vector3f sum = Vector3f::ZERO;
+				for (int k=0; k<count; k++) {
+					sum += from[neighbors[k]];
+				}
+				to[v] = from[v] + (sum / (float)count - from[v]) * factor;
+			}
+		});
+		std::swap(source, target);
+	}
+	if (source != &vertices) {
+		vertices.swap(buffer);
 	}
 
-	delete1(vertices);
-	delete1(indices);
+	mWeldIndex.clear();
+	mWeldedNum = 0;
 }
 
 
+
+void TBMesh::splitNormals(float creaseAngle, int *outIndices,
+						  std::vector<int> &sources, std::vector<Vector3f> &normals) const
+{
+	const std::vector<Vector3f> &vertices = getVertices();
+	const std::vector<int> &indices = getIndices();
+	int numVertices = vertices.size();
+	int numCorners = indices.size() / 3 * 3;
+
+	// Unit face normals, and the angle of every corner as its weight.
+	std::vector<Vector3f> faceNormals(numCorners / 3);
+	std::vector<float> weights(numCorners);
+	for (int t=0; t<numCorners; t+=3) {
+		const Vector3f *p[3] = { &vertices[indices[t]], &vertices[indices[t + 1]], &vertices[indices[t + 2]] };
+		Vector3f normal = (*p[1] - *p[0]).Cross(*p[2] - *p[0]);
+		normal.Normalize();
+		faceNormals[t / 3] = normal;
+		for (int k=0; k<3; k++) {
+			Vector3f e1 = *p[(k + 1) % 3] - *p[k];
+			Vector3f e2 = *p[(k + 2) % 3] - *p[k];
+			e1.Normalize();
+			e2.Normalize();
+			weights[t + k] = Mathf::ACos(e1.Dot(e2));
+		}
+	}
+
+	const TBMeshAdjacency &adjacency = getAdjacency();
+
+	float cosCrease = Mathf::Cos(creaseAngle);
+	sources.clear();
+	normals.clear();
+	sources.reserve(numVertices);
+	normals.reserve(numVertices);
+
+	for (int v=0; v<numVertices; v++) {
+		// Corners of the vertex, in triangle order.
+		int count;
+		const int *corners = adjacency.getVertexCorners(v, count);
+		for (int a=0; a<count; a++) {
+			const Vector3f &faceNormal = faceNormals[corners[a] / 3];
+
+			// Summed in the same order for every corner, so corners of a
+			// smooth vertex get bitwise equal normals.
+			Vector3f normal = Vector3f::ZERO;
+			for (int b=0; b<count; b++) {
+				const Vector3f &other = faceNormals[corners[b] / 3];
+				if (faceNormal.Dot(other) >= cosCrease) {
+					normal += other * weights[corners[b]];
+				}
+			}
+			if (normal.Normalize() <= 0.0f) {
+				normal = faceNormal;
+			}
+
+			int index = -1;
+			for (int b=0; b<a && index<0; b++) {
+				int shared = outIndices[corners[b]];
+				if (normals[shared] == normal) {
+					index = shared;
+				}
+			}
+			if (index < 0) {
+				index = sources.size();
+				sources.push_back(v);
+				normals.push_back(normal);
+			}
+			outIndices[corners[a]] = index;
+		}
+	}
+}
+
+void TBMesh::computeNormals(float creaseAngle, std::vector<Vector3f> &outVertices,
+							std::vector<int> &outIndices, std::vector<Vector3f> &normals) const
+{
+	const std::vector<Vector3f> &vertices = getVertices();
+	outIndices.resize(getIndices().size() / 3 * 3);
+	std::vector<int> sources;
+	splitNormals(creaseAngle, outIndices.empty() ? NULL : &outIndices[0], sources, normals);
+
+	outVertices.resize(sources.size());
+	for (int i=0; i<(int)sources.size(); i++) {
+		outVertices[i] = vertices[sources[i]];
+	}
+}
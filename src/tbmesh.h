@@ -1,39 +1,145 @@
 #ifndef TBMESH_H
 #define TBMESH_H
 
-#include <map>
 #include <vector>
+#include <memory>
+#include <mutex>
 #include "Wm5Vector3.h"
 #include "Wm5Transform.h"
+#include "tbaffine.h"
+#include "tbweldindex.h"
+#include "tbmeshadjacency.h"
 
 using namespace Wm5;
 
+// Settings of TBMesh::smooth.
+struct TBSmoothing
+{
+	int iterations;
+	// Each iteration moves every vertex lambda of the way to the average of
+	// its neighbours, then mu of the way; a negative mu slightly larger than
+	// lambda (Taubin) keeps the mesh from shrinking, mu = 0 is plain
+	// Laplacian smoothing.
+	float lambda;
+	float mu;
+	// Vertices on open edges stay put.
+	bool pinBoundary;
+	// Vertices on edges folding sharper than this, in radians, stay put;
+	// 0 pins none.
+	float featureAngle;
+
+	TBSmoothing() : iterations(1), lambda(0.5f), mu(0.0f), pinBoundary(true), featureAngle(0.0f) {}
+};
+
 class TBMesh
 {
 	public:
 		TBMesh();
 		~TBMesh();
 
-		TBMesh& transformBy(Transform);
+		// Applies the transform, together with any queued ones, in one pass.
+		// On a mesh that shares its storage with clones the transform is
+		// only queued, so the storage stays shared.
+		TBMesh& transformBy(const Transform&);
+
+		// Queued transforms form the per-instance transform. They are
+		// composed and run by applyTransforms(), or by the next call that
+		// changes the mesh.
+		TBMesh& queueTransform(const Transform&);
+		TBMesh& applyTransforms();
+		const TBAffine& getTransform() const;
+
+		// Returns a transformed copy, leaving this mesh untouched. It is
+		// caller's responsibility to clean up memory.
+		TBMesh *transformedBy(const Transform&) const;
 
 		void addTriangle(const Vector3f, const Vector3f, const Vector3f);
 
+		// Grows the storage for at least this many vertices and triangles.
+		void reserve(int numVertices, int numTriangles);
+
+		// Adds triangle soup, three corners per triangle, welding corners.
+		void addTriangles(const Vector3f *corners, int numTriangles);
+
+		// Appends an indexed mesh. Without weld the vertices are copied
+		// straight in; with weld each referenced vertex is welded once
+		// against the mesh and the indices are remapped.
+		void appendIndexed(const Vector3f *vertices, int numVertices,
+						   const int *indices, int numIndices,
+						   bool weld = false);
+
+		// Stitches closed rings of equal size into a tube, without welding.
+		// Consecutive rings are joined by quad strips matching sample i to
+		// sample i, and the first and last rings are closed by caps when
+		// asked to. Rings may be non-convex but should be roughly planar;
+		// the faces point outwards whichever way the rings wind.
+		void loft(const std::vector<Vector3f> *rings, int numRings,
+				  bool capBegin = true, bool capEnd = true);
+
+		// Corners closer than the tolerance on every axis share a vertex.
+		void setWeldTolerance(float tolerance);
+		float getWeldTolerance() const;
+
+		// Vertices with the per-instance transform applied. With a transform
+		// queued the result is built once and cached, so prefer
+		// getLocalVertices() and getTransform() when reading a clone. The
+		// const accessors may be called from several threads at once.
 		const std::vector<Vector3f>& getVertices() const;
+		const std::vector<Vector3f>& getLocalVertices() const;
 		const std::vector<int>& getIndices() const;
 
+		// Topology of the index buffer, built on first use and kept until
+		// the triangles change. Transforms keep it, and clones share it.
+		const TBMeshAdjacency& getAdjacency() const;
+
+		// Clones share the vertex and index storage until one of them is
+		// changed. The weld index is not cloned; it is rebuilt on demand.
 		TBMesh *clone() const;
 
-		void smooth();
+		// Neighbours are taken from the index buffer, so parts that are not
+		// welded are smoothed separately. The vertex adjacency is built once
+		// and each pass runs over blocks of vertices on the shared pool.
+		void smooth(const TBSmoothing &smoothing = TBSmoothing());
+
+		// Indexed render data with smooth normals. Each corner takes the
+		// corner angle weighted normals of the triangles around its vertex
+		// that lie within creaseAngle (radians) of its own triangle, so
+		// vertices are only split where the surface folds sharper than that.
+		// Corners of a vertex ending up with the same normal share an output
+		// vertex.
+		void computeNormals(float creaseAngle, std::vector<Vector3f> &vertices,
+							std::vector<int> &indices, std::vector<Vector3f> &normals) const;
+
+		// The same split without copying positions, for writing render
+		// buffers in place. Writes one output index per corner to indices,
+		// which must hold getIndices().size() entries, and returns for every
+		// output vertex its normal and the mesh vertex it comes from.
+		void splitNormals(float creaseAngle, int *indices,
+						  std::vector<int> &sources, std::vector<Vector3f> &normals) const;
 		
 	private:
-		std::string hashVertex(const Vector3f);
+		struct Geometry
+		{
+			std::vector<Vector3f> vertices;
+			std::vector<int> indices;
+		};
+
 		int pushVectex(const Vector3f);
+		void syncWeldIndex();
+		void makeUnique();
 
 	private:
 		int mVerticeNum;
-		std::vector<Vector3f> mVertices;
-		std::vector<int> mIndices;
-		std::map<std::string, int> mIndexedVertices;
+		int mWeldedNum;
+		bool mHasQueuedTransform;
+		TBAffine mQueuedTransform;
+		std::shared_ptr<Geometry> mGeometry;
+		// The caches below are filled by const calls, which may come from
+		// several threads at once; the mutex serializes filling them.
+		mutable std::mutex mCacheMutex;
+		mutable std::vector<Vector3f> mTransformedVertices;
+		mutable std::shared_ptr<const TBMeshAdjacency> mAdjacency;
+		TBWeldIndex mWeldIndex;
 };
 
 #endif
\ No newline at end of file
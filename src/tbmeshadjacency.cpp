@@ -0,0 +1,263 @@
+#include "tbmeshadjacency.h"
+#include <cstddef>
+
+TBMeshAdjacency::TBMeshAdjacency()
+{
+	clear();
+}
+
+TBMeshAdjacency::TBMeshAdjacency(const int *indices, int numIndices, int numVertices)
+{
+	build(indices, numIndices, numVertices);
+}
+
+void TBMeshAdjacency::clear()
+{
+	mNumVertices = 0;
+	mNumTriangles = 0;
+	mNumBoundaryEdges = 0;
+	mNumNonManifoldEdges = 0;
+	mNumComponents = 0;
+	mVertexOffsets.assign(1, 0);
+	mVertexCorners.clear();
+	mNeighborOffsets.assign(1, 0);
+	mNeighbors.clear();
+	mCornerEdges.clear();
+	mEdgeVertices.clear();
+	mEdgeOffsets.assign(1, 0);
+	mEdgeCorners.clear();
+	mComponents.clear();
+}
+
+void TBMeshAdjacency::build(const int *indices, int numIndices, int numVertices)
+{
+	clear();
+	mNumVertices = numVertices;
+	mNumTriangles = numIndices / 3;
+	int numCorners = mNumTriangles * 3;
+
+	// Corners of every vertex.
+	mVertexOffsets.assign(numVertices + 1, 0);
+	for (int c=0; c<numCorners; c++) {
+		mVertexOffsets[indices[c] + 1]++;
+	}
+	for (int v=0; v<numVertices; v++) {
+		mVertexOffsets[v + 1] += mVertexOffsets[v];
+	}
+	mVertexCorners.resize(numCorners);
+	std::vector<int> next(mVertexOffsets.begin(), mVertexOffsets.end() - 1);
+	for (int c=0; c<numCorners; c++) {
+		mVertexCorners[next[indices[c]]++] = c;
+	}
+
+	// Edges are numbered while visiting their lower vertex. Around vertex a
+	// every corner c sees its own edge to the next vertex and the edge of
+	// the previous corner, which ends at a; the one whose other end is
+	// higher than a is created or looked up in the per vertex stamp table.
+	mCornerEdges.assign(numCorners, -1);
+	std::vector<int> stamp(numVertices, -1);
+	std::vector<int> slot(numVertices);
+	for (int a=0; a<numVertices; a++) {
+		for (int i=mVertexOffsets[a]; i<mVertexOffsets[a + 1]; i++) {
+			int c = mVertexCorners[i];
+			int base = c - c % 3;
+			int nextCorner = base + (c - base + 1) % 3;
+			int prevCorner = base + (c - base + 2) % 3;
+			int ends[2] = { indices[nextCorner], indices[prevCorner] };
+			int corners[2] = { c, prevCorner };
+			for (int k=0; k<2; k++) {
+				int b = ends[k];
+				if (b <= a) {
+					continue;
+				}
+				if (stamp[b] != a) {
+					stamp[b] = a;
+					slot[b] = mEdgeVertices.size() / 2;
+					mEdgeVertices.push_back(a);
+					mEdgeVertices.push_back(b);
+				}
+				// The own corner runs a to b, forwards; the previous one b to a.
+				mCornerEdges[corners[k]] = (slot[b] << 1) | (k == 0 ? 1 : 0);
+			}
+		}
+	}
+	int numEdges = mEdgeVertices.size() / 2;
+
+	// Sides of every edge.
+	mEdgeOffsets.assign(numEdges + 1, 0);
+	for (int c=0; c<numCorners; c++) {
+		if (mCornerEdges[c] >= 0) {
+			mEdgeOffsets[(mCornerEdges[c] >> 1) + 1]++;
+		}
+	}
+	for (int e=0; e<numEdges; e++) {
+		mEdgeOffsets[e + 1] += mEdgeOffsets[e];
+	}
+	mEdgeCorners.resize(mEdgeOffsets[numEdges]);
+	next.assign(mEdgeOffsets.begin(), mEdgeOffsets.end() - 1);
+	for (int c=0; c<numCorners; c++) {
+		if (mCornerEdges[c] >= 0) {
+			mEdgeCorners[next[mCornerEdges[c] >> 1]++] = c;
+		}
+	}
+	for (int e=0; e<numEdges; e++) {
+		int count = mEdgeOffsets[e + 1] - mEdgeOffsets[e];
+		if (count == 1) {
+			mNumBoundaryEdges++;
+		} else if (count > 2) {
+			mNumNonManifoldEdges++;
+		}
+	}
+
+	// Neighbours, straight from the edges.
+	mNeighborOffsets.assign(numVertices + 1, 0);
+	for (int e=0; e<numEdges; e++) {
+		mNeighborOffsets[mEdgeVertices[e*2] + 1]++;
+		mNeighborOffsets[mEdgeVertices[e*2 + 1] + 1]++;
+	}
+	for (int v=0; v<numVertices; v++) {
+		mNeighborOffsets[v + 1] += mNeighborOffsets[v];
+	}
+	mNeighbors.resize(numEdges * 2);
+	next.assign(mNeighborOffsets.begin(), mNeighborOffsets.end() - 1);
+	for (int e=0; e<numEdges; e++) {
+		int a = mEdgeVertices[e*2];
+		int b = mEdgeVertices[e*2 + 1];
+		mNeighbors[next[a]++] = b;
+		mNeighbors[next[b]++] = a;
+	}
+
+	// Components by union-find over the triangles of every edge.
+	std::vector<int> parent(mNumTriangles);
+	for (int t=0; t<mNumTriangles; t++) {
+		parent[t] = t;
+	}
+	for (int e=0; e<numEdges; e++) {
+		for (int i=mEdgeOffsets[e] + 1; i<mEdgeOffsets[e + 1]; i++) {
+			int r1 = mEdgeCorners[mEdgeOffsets[e]] / 3;
+			int r2 = mEdgeCorners[i] / 3;
+			while (parent[r1] != r1) {
+				r1 = parent[r1] = parent[parent[r1]];
+			}
+			while (parent[r2] != r2) {
+				r2 = parent[r2] = parent[parent[r2]];
+			}
+			if (r1 != r2) {
+				parent[r1 > r2 ? r1 : r2] = r1 < r2 ? r1 : r2;
+			}
+		}
+	}
+	// Roots are the lowest triangle of their component, so numbering the
+	// roots in order numbers the components by first triangle.
+	mComponents.resize(mNumTriangles);
+	for (int t=0; t<mNumTriangles; t++) {
+		int root = t;
+		while (parent[root] != root) {
+			root = parent[root];
+		}
+		mComponents[t] = root == t ? mNumComponents++ : mComponents[root];
+	}
+}
+
+int TBMeshAdjacency::getNumVertices() const
+{
+	return mNumVertices;
+}
+
+int TBMeshAdjacency::getNumTriangles() const
+{
+	return mNumTriangles;
+}
+
+int TBMeshAdjacency::getNumEdges() const
+{
+	return mEdgeVertices.size() / 2;
+}
+
+const int *TBMeshAdjacency::getVertexCorners(int vertex, int &count) const
+{
+	count = mVertexOffsets[vertex + 1] - mVertexOffsets[vertex];
+	return count > 0 ? &mVertexCorners[mVertexOffsets[vertex]] : NULL;
+}
+
+const int *TBMeshAdjacency::getVertexNeighbors(int vertex, int &count) const
+{
+	count = mNeighborOffsets[vertex + 1] - mNeighborOffsets[vertex];
+	return count > 0 ? &mNeighbors[mNeighborOffsets[vertex]] : NULL;
+}
+
+int TBMeshAdjacency::getCornerEdge(int corner) const
+{
+	int value = mCornerEdges[corner];
+	return value < 0 ? -1 : value >> 1;
+}
+
+bool TBMeshAdjacency::isCornerForward(int corner) const
+{
+	return mCornerEdges[corner] >= 0 && (mCornerEdges[corner] & 1) != 0;
+}
+
+void TBMeshAdjacency::getEdgeVertices(int edge, int &lower, int &upper) const
+{
+	lower = mEdgeVertices[edge*2];
+	upper = mEdgeVertices[edge*2 + 1];
+}
+
+const int *TBMeshAdjacency::getEdgeCorners(int edge, int &count) const
+{
+	count = mEdgeOffsets[edge + 1] - mEdgeOffsets[edge];
+	return count > 0 ? &mEdgeCorners[mEdgeOffsets[edge]] : NULL;
+}
+
+int TBMeshAdjacency::findEdge(int a, int b) const
+{
+	if (a > b) {
+		int swap = a;
+		a = b;
+		b = swap;
+	}
+	// The lower vertex's corners see every edge it owns.
+	for (int i=mVertexOffsets[a]; i<mVertexOffsets[a + 1]; i++) {
+		int c = mVertexCorners[i];
+		int base = c - c % 3;
+		int prevCorner = base + (c - base + 2) % 3;
+		int candidates[2] = { c, prevCorner };
+		for (int k=0; k<2; k++) {
+			int edge = getCornerEdge(candidates[k]);
+			if (edge >= 0 && mEdgeVertices[edge*2] == a && mEdgeVertices[edge*2 + 1] == b) {
+				return edge;
+			}
+		}
+	}
+	return -1;
+}
+
+bool TBMeshAdjacency::isBoundaryEdge(int edge) const
+{
+	return mEdgeOffsets[edge + 1] - mEdgeOffsets[edge] == 1;
+}
+
+bool TBMeshAdjacency::isManifoldEdge(int edge) const
+{
+	return mEdgeOffsets[edge + 1] - mEdgeOffsets[edge] <= 2;
+}
+
+int TBMeshAdjacency::getNumBoundaryEdges() const
+{
+	return mNumBoundaryEdges;
+}
+
+int TBMeshAdjacency::getNumNonManifoldEdges() const
+{
+	return mNumNonManifoldEdges;
+}
+
+int TBMeshAdjacency::getNumComponents() const
+{
+	return mNumComponents;
+}
+
+int TBMeshAdjacency::getTriangleComponent(int triangle) const
+{
+	return mComponents[triangle];
+}
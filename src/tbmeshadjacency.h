@@ -0,0 +1,77 @@
+#ifndef TBMESHADJACENCY_H
+#define TBMESHADJACENCY_H
+
+#include <vector>
+
+// Topology of an indexed triangle mesh in flat arrays.
+//
+// Corner c is index c of the index buffer, in triangle c / 3, and its edge
+// runs to the next corner of the triangle. Vertex to corner, vertex to
+// neighbour and edge to corner lists are stored CSR style: one offset array
+// and one packed array each. Edges are undirected and numbered from their
+// lower vertex. Everything is built in a single linear pass.
+class TBMeshAdjacency
+{
+	public:
+		TBMeshAdjacency();
+		TBMeshAdjacency(const int *indices, int numIndices, int numVertices);
+
+		void build(const int *indices, int numIndices, int numVertices);
+		void clear();
+
+		int getNumVertices() const;
+		int getNumTriangles() const;
+		int getNumEdges() const;
+
+		// Corners using the vertex, in index buffer order.
+		const int *getVertexCorners(int vertex, int &count) const;
+		// Distinct vertices sharing an edge with the vertex.
+		const int *getVertexNeighbors(int vertex, int &count) const;
+
+		// Edge of the corner, -1 for a corner repeating the next vertex.
+		int getCornerEdge(int corner) const;
+		// Whether the corner runs from the lower vertex of its edge to the
+		// higher one. Two triangles are consistently oriented along an edge
+		// when their corners run in opposite directions.
+		bool isCornerForward(int corner) const;
+
+		void getEdgeVertices(int edge, int &lower, int &upper) const;
+		// Corners whose edge this is, one per triangle side.
+		const int *getEdgeCorners(int edge, int &count) const;
+		int findEdge(int a, int b) const;
+
+		// An edge with a single side is open, one with more than two is not
+		// manifold.
+		bool isBoundaryEdge(int edge) const;
+		bool isManifoldEdge(int edge) const;
+		int getNumBoundaryEdges() const;
+		int getNumNonManifoldEdges() const;
+
+		// Triangles connected through edges share a component; components
+		// are numbered in the order of their first triangle.
+		int getNumComponents() const;
+		int getTriangleComponent(int triangle) const;
+
+	private:
+		int mNumVertices;
+		int mNumTriangles;
+
+		std::vector<int> mVertexOffsets;
+		std::vector<int> mVertexCorners;
+		std::vector<int> mNeighborOffsets;
+		std::vector<int> mNeighbors;
+
+		// Edge of each corner shifted left by one, with the forward flag in
+		// bit 0; -1 for degenerate corners.
+		std::vector<int> mCornerEdges;
+		std::vector<int> mEdgeVertices;
+		std::vector<int> mEdgeOffsets;
+		std::vector<int> mEdgeCorners;
+		int mNumBoundaryEdges;
+		int mNumNonManifoldEdges;
+
+		std::vector<int> mComponents;
+		int mNumComponents;
+};
+
+#endif
@@ -1,6 +1,10 @@
 
 #include "tbmeshboolean.h"
+#include "tbnativeboolean.h"
+#include "tbthreadpool.h"
 #include "tbmesh.h"
+#include <algorithm>
+#include <mutex>
 
 extern "C" {
     #include "gts.h"
@@ -8,20 +12,32 @@ extern "C" {
 
 namespace {
 
-static std::string getEdgeKey(int ia, int ib) {
-	std::string key;
-	char stemp[200] = "";
-	snprintf(stemp, 200, "%d-", ia);
-	key += std::string(stemp);
-	snprintf(stemp, 200, "%d", ib);
-	key += std::string(stemp);
-	return key;
+// Collects a surface into index buffers. The vertex indices are kept in
+// the reserved field of the GTS objects while the faces are walked.
+struct SurfaceExport
+{
+	std::vector<Vector3f> vertices;
+	std::vector<int> indices;
+};
+
+static void export_vertex (GtsVertex * v, SurfaceExport * e)
+{
+	GTS_OBJECT (v)->reserved = GINT_TO_POINTER (e->vertices.size());
+	e->vertices.push_back(Vector3f(GTS_POINT(v)->x, GTS_POINT(v)->y, GTS_POINT(v)->z));
 }
 
-static void build_list (gpointer data, GSList ** list)
+static void export_face (GtsTriangle * t, SurfaceExport * e)
 {
-  /* always use O(1) g_slist_prepend instead of O(n) g_slist_append */
-  *list = g_slist_prepend (*list, data);
+	GtsVertex * p1, * p2, * p3;
+	gts_triangle_vertices (t, &p1, &p2, &p3);
+	e->indices.push_back(GPOINTER_TO_INT (GTS_OBJECT (p1)->reserved));
+	e->indices.push_back(GPOINTER_TO_INT (GTS_OBJECT (p2)->reserved));
+	e->indices.push_back(GPOINTER_TO_INT (GTS_OBJECT (p3)->reserved));
+}
+
+static void reset_reserved (GtsObject * o, gpointer)
+{
+	o->reserved = NULL;
 }
 
 static void prepend_triangle_bbox (GtsTriangle * t, GSList ** bboxes)
@@ -29,33 +45,36 @@ static void prepend_triangle_bbox (GtsTriangle * t, GSList ** bboxes)
   *bboxes = g_slist_prepend (*bboxes, gts_bbox_triangle (gts_bbox_class (), t));
 }
 
-static void tbMeshFromGtsSurface(GtsSurface * s, TBMesh &mesh)
+static void tbMeshFromGtsSurface(GtsSurface * s, TBMesh &mesh, bool reverse = false)
 {
-	/* build list of triangles */
-	GSList * triangles = NULL;
-	gts_surface_foreach_face (s, (GtsFunc)build_list, &triangles);
-	GSList * i = triangles;
-	while (i)
-	{
-		GtsVertex * p1, * p2, * p3;
-		GtsTriangle * t = (GtsTriangle *)i->data;
-		gts_triangle_vertices (t, &p1, &p2, &p3);
+	SurfaceExport e;
+	e.vertices.reserve(gts_surface_vertex_number (s));
+	e.indices.reserve(gts_surface_face_number (s) * 3);
+	gts_surface_foreach_vertex (s, (GtsFunc) export_vertex, &e);
+	gts_surface_foreach_face (s, (GtsFunc) export_face, &e);
+	gts_surface_foreach_vertex (s, (GtsFunc) reset_reserved, NULL);
 
-		Vector3f v1( GTS_POINT(p1)->x, GTS_POINT(p1)->y, GTS_POINT(p1)->z);
-		Vector3f v2( GTS_POINT(p2)->x, GTS_POINT(p2)->y, GTS_POINT(p2)->z);
-		Vector3f v3( GTS_POINT(p3)->x, GTS_POINT(p3)->y, GTS_POINT(p3)->z);
-		mesh.addTriangle(v1, v2, v3);
-
-		i = i->next;
+	if (e.indices.empty()) {
+		return;
+	}
+	if (reverse) {
+		for (int i=0; i<(int)e.indices.size(); i+=3) {
+			std::swap(e.indices[i + 1], e.indices[i + 2]);
+		}
 	}
 
-	/* free list of triangles */
-	g_slist_free (triangles);
+	// GTS surfaces are connected already; only weld against triangles that
+	// were in the mesh before, such as another part of the same result.
+	bool weld = !mesh.getIndices().empty();
+	mesh.appendIndexed(&e.vertices[0], e.vertices.size(), &e.indices[0], e.indices.size(), weld);
 }
 
 static GtsSurface * gtsSurfaceFromTBMesh(const TBMesh &mesh)
 {
-	const std::vector<Vector3f>& vertices = mesh.getVertices() ;
+	// Read the local vertices and apply the instance transform here, so a
+	// clone that shares its storage is not materialized.
+	const std::vector<Vector3f>& vertices = mesh.getLocalVertices();
+	const TBAffine& xform = mesh.getTransform();
 	const std::vector<int>& indices = mesh.getIndices();
 
 	GtsSurface *s = gts_surface_new (gts_surface_class (),
@@ -65,79 +84,289 @@ static GtsSurface * gtsSurfaceFromTBMesh(const TBMesh &mesh)
 
 	// Create gts vertices.
 	std::vector<GtsVertex *> gtsVertices;
+	gtsVertices.reserve(vertices.size());
 	std::vector<Vector3f>::const_iterator vit = vertices.begin();
 	for (; vit != vertices.end(); vit++) {
-		Vector3f v = *vit;
+		Vector3f v = xform * (*vit);
 		GtsVertex * gv = gts_vertex_new (s->vertex_class, v.X(), v.Y(), v.Z());
 		gtsVertices.push_back(gv);
 	}
 
-	std::map<std::string, GtsEdge*> edgeMap;
-
-	// Create gts edges.
-	std::vector<int>::const_iterator it = indices.begin();
-	for (; it != indices.end(); it+=3) {
-		int i1 = *it;
-		int i2 = *(it+1);
-		int i3 = *(it+2);
+	// One GTS edge per edge of the shared adjacency.
+	const TBMeshAdjacency& adjacency = mesh.getAdjacency();
+	std::vector<GtsEdge *> gtsEdges(adjacency.getNumEdges());
+	for (int e=0; e<(int)gtsEdges.size(); e++) {
+		int lower, upper;
+		adjacency.getEdgeVertices(e, lower, upper);
+		gtsEdges[e] = gts_edge_new (s->edge_class, gtsVertices[lower], gtsVertices[upper]);
+	}
 
+	// Add faces.
+	int numCorners = indices.size() / 3 * 3;
+	for (int t=0; t<numCorners; t+=3) {
 		GtsEdge *edges[3];
-		int edgeIndices[] = {i1, i2, i2, i3, i3, i1};
-		for (int i=0; i<3; i++) {
-			int e1 = edgeIndices[i*2];
-			int e2 = edgeIndices[i*2+1];
-			std::string key1 = getEdgeKey(e1, e2);
-			std::string key2 = getEdgeKey(e2, e1);
-			std::map<std::string, GtsEdge*>::iterator it = edgeMap.find(key1);
-			if (it != edgeMap.end()) {
-				edges[i] = it->second;
-			} else {
-				GtsEdge *edge = gts_edge_new (s->edge_class, gtsVertices[e1], gtsVertices[e2]);
-				edgeMap[key1] = edge;
-				edgeMap[key2] = edge;
-				edges[i] = edge;
-			}
+		for (int k=0; k<3; k++) {
+			int edge = adjacency.getCornerEdge(t + k);
+			edges[k] = edge >= 0 ? gtsEdges[edge]
+				: gts_edge_new (s->edge_class, gtsVertices[indices[t + k]], gtsVertices[indices[t + k]]);
 		}
-
-		// Add face.
 		gts_surface_add_face (s, gts_face_new (s->face_class, edges[0], edges[1], edges[2]));
 	}
 	return s;
 }
-}
 
-void TBBoolean::add(const TBMesh &m1, const TBMesh &m2, TBMesh &result)
+static TBBoolean::Status checkManifold(const std::vector<int> &indices,
+										const TBMeshAdjacency &adjacency)
 {
-	GtsSurface *s1 = gtsSurfaceFromTBMesh(m1);
-	GtsSurface *s2 = gtsSurfaceFromTBMesh(m2);
+	int numTriangles = indices.size() / 3;
+	for (int t=0; t<numTriangles; t++) {
+		const int *v = &indices[t*3];
+		if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0]) {
+			return TBBoolean::STATUS_DEGENERATE;
+		}
+	}
 
-	/* check surfaces */
-	g_assert (gts_surface_is_orientable (s1));
-	g_assert (gts_surface_is_orientable (s2));
-	g_assert (!gts_surface_is_self_intersecting (s1));
-	g_assert (!gts_surface_is_self_intersecting (s2));
+	// A closed oriented surface has two sides per edge, running in opposite
+	// directions.
+	for (int e=0; e<adjacency.getNumEdges(); e++) {
+		int count;
+		const int *corners = adjacency.getEdgeCorners(e, count);
+		if (count == 1) {
+			return TBBoolean::STATUS_OPEN;
+		}
+		if (count > 2) {
+			return TBBoolean::STATUS_NON_MANIFOLD;
+		}
+		if (adjacency.isCornerForward(corners[0]) == adjacency.isCornerForward(corners[1])) {
+			return TBBoolean::STATUS_NOT_ORIENTED;
+		}
+	}
+	return TBBoolean::STATUS_OK;
+}
 
-	/* build bounding boxes for first surface */
+static GNode *gtsTreeFromSurface(GtsSurface *s)
+{
+	/* build bounding boxes for the surface */
 	GSList *bboxes = NULL;
-	gts_surface_foreach_face (s1, (GtsFunc) prepend_triangle_bbox, &bboxes);
-	/* build bounding box tree for first surface */
-	GNode *tree1 = gts_bb_tree_new (bboxes);
+	gts_surface_foreach_face (s, (GtsFunc) prepend_triangle_bbox, &bboxes);
+	/* build bounding box tree for the surface */
+	GNode *tree = gts_bb_tree_new (bboxes);
 	/* free list of bboxes */
 	g_slist_free (bboxes);
-	gboolean is_open1 = gts_surface_volume (s1) < 0. ? TRUE : FALSE;
+	return tree;
+}
+}
 
-	/* build bounding boxes for second surface */
-	bboxes = NULL;
-	gts_surface_foreach_face (s2, (GtsFunc) prepend_triangle_bbox, &bboxes);
-	/* build bounding box tree for second surface */
-	GNode *tree2 = gts_bb_tree_new (bboxes);
-	/* free list of bboxes */
-	g_slist_free (bboxes);
-	gboolean is_open2 = gts_surface_volume (s2) < 0. ? TRUE : FALSE;
+TBBoolean::Validation TBBoolean::sValidation = TBBoolean::VALIDATE_MANIFOLD;
+
+TBBooleanOperand::TBBooleanOperand()
+{
+	mMesh = NULL;
+	mSurface = NULL;
+	mTree = NULL;
+	mIsOpen = false;
+	mNative = NULL;
+	mValidated = TBBoolean::VALIDATE_NONE;
+	mStatus = TBBoolean::STATUS_OK;
+}
+
+TBBooleanOperand::TBBooleanOperand(const TBMesh &mesh)
+{
+	mMesh = mesh.clone();
+	mSurface = NULL;
+	mTree = NULL;
+	mIsOpen = false;
+	mNative = NULL;
+	mValidated = TBBoolean::VALIDATE_NONE;
+	mStatus = TBBoolean::STATUS_OK;
+}
+
+TBBooleanOperand::~TBBooleanOperand()
+{
+	clear();
+}
+
+void TBBooleanOperand::clear()
+{
+	if (mTree) {
+		gts_bb_tree_destroy (mTree, TRUE);
+		mTree = NULL;
+	}
+	if (mSurface) {
+		gts_object_destroy (GTS_OBJECT (mSurface));
+		mSurface = NULL;
+	}
+	delete0(mNative);
+	mNative = NULL;
+	delete0(mMesh);
+	mMesh = NULL;
+	mValidated = TBBoolean::VALIDATE_NONE;
+	mStatus = TBBoolean::STATUS_OK;
+}
+
+void TBBooleanOperand::setMesh(const TBMesh &mesh)
+{
+	clear();
+	mMesh = mesh.clone();
+}
+
+const TBMesh &TBBooleanOperand::getMesh() const
+{
+	if (!mMesh) {
+		mMesh = new0 TBMesh();
+		if (mNative) {
+			mNative->toMesh(*mMesh);
+		} else if (mSurface) {
+			tbMeshFromGtsSurface(mSurface, *mMesh);
+		}
+	}
+	return *mMesh;
+}
+
+GtsSurface *TBBooleanOperand::getSurface() const
+{
+	if (!mSurface) {
+		mSurface = gtsSurfaceFromTBMesh(getMesh());
+	}
+	return mSurface;
+}
+
+GNode *TBBooleanOperand::getTree() const
+{
+	if (!mTree) {
+		GtsSurface *s = getSurface();
+		mTree = gtsTreeFromSurface(s);
+		mIsOpen = gts_surface_volume (s) < 0. ? true : false;
+	}
+	return mTree;
+}
+
+const TBNativeOperand &TBBooleanOperand::getNative() const
+{
+	if (!mNative) {
+		mNative = new0 TBNativeOperand();
+		mNative->load(getMesh());
+	}
+	return *mNative;
+}
+
+void TBBoolean::setValidation(Validation validation)
+{
+	sValidation = validation;
+}
+
+TBBoolean::Validation TBBoolean::getValidation()
+{
+	return sValidation;
+}
+
+const char *TBBoolean::getStatusName(Status status)
+{
+	switch (status) {
+		case STATUS_OK: return "ok";
+		case STATUS_DEGENERATE: return "degenerate triangle";
+		case STATUS_OPEN: return "open edge";
+		case STATUS_NON_MANIFOLD: return "non-manifold edge";
+		case STATUS_NOT_ORIENTED: return "inconsistent orientation";
+		case STATUS_SELF_INTERSECTING: return "self intersection";
+	}
+	return "unknown";
+}
+
+TBBoolean::Status TBBoolean::validate(const TBMesh &mesh, Validation validation)
+{
+	if (validation == VALIDATE_NONE) {
+		return STATUS_OK;
+	}
+	Status status = checkManifold(mesh.getIndices(), mesh.getAdjacency());
+	if (status != STATUS_OK || validation == VALIDATE_MANIFOLD) {
+		return status;
+	}
+	TBNativeOperand operand;
+	operand.load(mesh);
+	return operand.isSelfIntersecting() ? STATUS_SELF_INTERSECTING : STATUS_OK;
+}
+
+TBBoolean::Status TBBoolean::check(const TBNativeOperand &operand, Validation validation)
+{
+	if (validation == VALIDATE_NONE) {
+		return STATUS_OK;
+	}
+	TBMeshAdjacency adjacency(operand.indices.empty() ? NULL : &operand.indices[0],
+							  operand.indices.size(), operand.vertices.size());
+	Status status = checkManifold(operand.indices, adjacency);
+	if (status != STATUS_OK || validation == VALIDATE_MANIFOLD) {
+		return status;
+	}
+	return operand.isSelfIntersecting() ? STATUS_SELF_INTERSECTING : STATUS_OK;
+}
+
+TBBoolean::Status TBBoolean::check(const TBBooleanOperand &operand)
+{
+	if (operand.mValidated >= sValidation || operand.mStatus != STATUS_OK) {
+		return operand.mStatus;
+	}
+	if (operand.mValidated < VALIDATE_MANIFOLD) {
+		const TBMesh &mesh = operand.getMesh();
+		operand.mStatus = checkManifold(mesh.getIndices(), mesh.getAdjacency());
+		operand.mValidated = VALIDATE_MANIFOLD;
+	}
+	if (operand.mStatus == STATUS_OK && sValidation == VALIDATE_FULL) {
+		if (operand.getNative().isSelfIntersecting()) {
+			operand.mStatus = STATUS_SELF_INTERSECTING;
+		}
+		operand.mValidated = VALIDATE_FULL;
+	}
+	return operand.mStatus;
+}
+
+TBBoolean::Status TBBoolean::add(const TBMesh &m1, const TBMesh &m2, TBMesh &result, Engine engine)
+{
+	TBBooleanResults results;
+	results.unite = &result;
+	return compute(m1, m2, results, engine);
+}
+
+TBBoolean::Status TBBoolean::add(const TBBooleanOperand &m1, const TBBooleanOperand &m2,
+								 TBBooleanOperand &result, Engine engine)
+{
+	Status status = check(m1);
+	if (status == STATUS_OK) {
+		status = check(m2);
+	}
+	if (status != STATUS_OK) {
+		return status;
+	}
+
+	// result may alias an operand, so it is only replaced at the end.
+	// Pairs the native engine leaves unresolved go to GTS.
+	if (engine == ENGINE_NATIVE) {
+		TBNativeOperand *native = new0 TBNativeOperand();
+		bool resolved;
+		{
+			TBNativeBoolean boolean(m1.getNative(), m2.getNative());
+			resolved = boolean.isResolved();
+			if (resolved) {
+				boolean.collect(TBNativeBoolean::A_OUT_B | TBNativeBoolean::B_OUT_A, 0, *native);
+			}
+		}
+		if (resolved) {
+			result.clear();
+			result.mNative = native;
+			result.mValidated = VALIDATE_FULL;
+			return STATUS_OK;
+		}
+		delete0(native);
+	}
+
+	GtsSurface *s1 = m1.getSurface();
+	GtsSurface *s2 = m2.getSurface();
+	GNode *tree1 = m1.getTree();
+	GNode *tree2 = m2.getTree();
 
 	/* boolean surface */
 	GtsSurfaceInter *si = gts_surface_inter_new (gts_surface_inter_class (), 
-				s1, s2, tree1, tree2, is_open1, is_open2);
+				s1, s2, tree1, tree2, m1.mIsOpen, m2.mIsOpen);
 
 	GtsSurface * s3 = gts_surface_new (gts_surface_class (),
 										gts_face_class (),
@@ -147,29 +376,337 @@ void TBBoolean::add(const TBMesh &m1, const TBMesh &m2, TBMesh &result)
 	gts_surface_inter_boolean (si, s3, GTS_1_OUT_2);
 	gts_surface_inter_boolean (si, s3, GTS_2_OUT_1);
 
-	/* get result from s3 */
-	tbMeshFromGtsSurface(s3, result);
-
-	/* destroy surfaces and intersection */
-	gts_object_destroy (GTS_OBJECT (s1));
-	gts_object_destroy (GTS_OBJECT (s2));
-	gts_object_destroy (GTS_OBJECT (s3));
+	/* destroy intersection, s3 keeps references to the faces it uses */
 	gts_object_destroy (GTS_OBJECT (si));
 
-	/* destroy bounding box trees (including bounding boxes) */
-	gts_bb_tree_destroy (tree1, TRUE);
-	gts_bb_tree_destroy (tree2, TRUE);
+	// The result surface is validated by construction; its tree and volume
+	// are computed when it is used as an operand.
+	result.clear();
+	result.mSurface = s3;
+	result.mValidated = VALIDATE_FULL;
+	return STATUS_OK;
 }
 
 
-void TBBoolean::sub(const TBMesh &m1, const TBMesh &m2, TBMesh &result)
+TBBoolean::Status TBBoolean::unionAll(const std::vector<const TBMesh *> &meshes, TBMesh &result,
+									  Engine engine)
 {
-	// TODO:
+	int numMeshes = meshes.size();
+	if (numMeshes == 0) {
+		return STATUS_OK;
+	}
+
+	if (engine == ENGINE_GTS) {
+		TBBooleanOperand accumulated(*meshes[0]);
+		for (int i=1; i<numMeshes; i++) {
+			TBBooleanOperand operand(*meshes[i]);
+			Status status = add(operand, accumulated, accumulated, ENGINE_GTS);
+			if (status != STATUS_OK) {
+				return status;
+			}
+		}
+		const TBMesh &mesh = accumulated.getMesh();
+		if (!mesh.getIndices().empty()) {
+			result.appendIndexed(&mesh.getVertices()[0], mesh.getVertices().size(),
+								 &mesh.getIndices()[0], mesh.getIndices().size());
+		}
+		return STATUS_OK;
+	}
+
+	TBThreadPool &pool = TBThreadPool::getShared();
+	std::vector<TBNativeOperand *> operands(numMeshes);
+	for (int i=0; i<numMeshes; i++) {
+		operands[i] = new0 TBNativeOperand();
+	}
+	std::vector<Status> statuses(numMeshes);
+	Validation validation = sValidation;
+	pool.parallelFor(numMeshes, [&](int i) {
+		operands[i]->load(*meshes[i]);
+		statuses[i] = check(*operands[i], validation);
+	});
+	for (int i=0; i<numMeshes; i++) {
+		if (statuses[i] != STATUS_OK) {
+			for (int j=0; j<numMeshes; j++) {
+				delete0(operands[j]);
+			}
+			return statuses[i];
+		}
+	}
+
+	Status status = reduceUnion(std::vector<const TBNativeOperand *>(operands.begin(), operands.end()),
+								NULL, NULL, result);
+	for (int i=0; i<numMeshes; i++) {
+		delete0(operands[i]);
+	}
+	return status;
 }
 
-void TBBoolean::diff(const TBMesh &m1, const TBMesh &m2, TBMesh &result)
+TBBoolean::Status TBBoolean::unionAll(const std::vector<const TBNativeOperand *> &operands,
+									  const std::vector<unsigned long long> &keys, TBUnionCache &cache,
+									  TBMesh &result)
 {
-	// TODO:
+	assertion(keys.size() == operands.size(), "Every operand needs a key.\n");
+	if (operands.empty()) {
+		return STATUS_OK;
+	}
+	return reduceUnion(operands, &keys[0], &cache, result);
+}
+
+TBBoolean::Status TBBoolean::reduceUnion(const std::vector<const TBNativeOperand *> &operands,
+										 const unsigned long long *keys, TBUnionCache *cache,
+										 TBMesh &result)
+{
+	// A node owns its operand unless it is one of the inputs.
+	struct Node
+	{
+		const TBNativeOperand *operand;
+		std::shared_ptr<const TBNativeOperand> owned;
+		unsigned long long key;
+	};
+	int numOperands = operands.size();
+
+	// Sort along the widest axis so neighbours in the reduction tree are
+	// close to each other and distant operands get concatenated early.
+	std::vector<TBBox> bounds(numOperands);
+	TBBox all;
+	for (int i=0; i<numOperands; i++) {
+		bounds[i] = operands[i]->getBounds();
+		all.include(bounds[i]);
+	}
+	int axis = 0;
+	for (int k=1; k<3; k++) {
+		if (all.max[k] - all.min[k] > all.max[axis] - all.min[axis]) {
+			axis = k;
+		}
+	}
+	std::vector<std::pair<double, int> > order(numOperands);
+	for (int i=0; i<numOperands; i++) {
+		order[i] = std::make_pair(bounds[i].min[axis] + bounds[i].max[axis], i);
+	}
+	std::sort(order.begin(), order.end());
+	std::vector<Node> level(numOperands);
+	for (int i=0; i<numOperands; i++) {
+		level[i].operand = operands[order[i].second];
+		level[i].key = keys ? keys[order[i].second] : 0;
+	}
+
+	if (cache) {
+		cache->mNumReused = 0;
+		cache->mNumComputed = 0;
+	}
+	TBThreadPool &pool = TBThreadPool::getShared();
+	Status status = STATUS_OK;
+	while (level.size() > 1 && status == STATUS_OK) {
+		int numPairs = level.size() / 2;
+		std::vector<Node> next((level.size() + 1) / 2);
+		if (level.size() % 2 == 1) {
+			next.back() = level.back();
+		}
+
+		// Cache lookups stay out of the parallel loop.
+		std::vector<int> missing;
+		for (int i=0; i<numPairs; i++) {
+			const Node &a = level[i*2];
+			const Node &b = level[i*2 + 1];
+			next[i].key = (a.key * 0x9e3779b97f4a7c15ULL) ^ (b.key + 0x632be59bd9b4e019ULL + (a.key << 6) + (a.key >> 2));
+			TBUnionCache::Map::iterator found;
+			if (cache && (found = cache->mPairs.find(next[i].key)) != cache->mPairs.end()) {
+				next[i].owned = found->second.operand;
+				found->second.generation = cache->mGeneration;
+				cache->mNumReused++;
+			} else {
+				missing.push_back(i);
+			}
+		}
+
+		// Pairs the native engine leaves unresolved go to GTS. A pair GTS
+		// fails on ends the reduction; the others of the level are still
+		// cached.
+		std::vector<Status> statuses(missing.size(), STATUS_OK);
+		pool.parallelFor(missing.size(), [&](int m) {
+			int i = missing[m];
+			const TBNativeOperand &a = *level[i*2].operand;
+			const TBNativeOperand &b = *level[i*2 + 1].operand;
+			std::shared_ptr<TBNativeOperand> pair = std::make_shared<TBNativeOperand>();
+			if (!a.getBounds().overlaps(b.getBounds())) {
+				*pair = a;
+				pair->append(b);
+			} else {
+				TBNativeBoolean boolean(a, b);
+				if (boolean.isResolved()) {
+					boolean.collect(TBNativeBoolean::A_OUT_B | TBNativeBoolean::B_OUT_A, 0, *pair);
+				} else {
+					statuses[m] = addWithGts(a, b, *pair);
+				}
+			}
+			next[i].owned = pair;
+		});
+
+		for (int i=0; i<numPairs; i++) {
+			next[i].operand = next[i].owned.get();
+		}
+		for (size_t m=0; m<missing.size(); m++) {
+			if (statuses[m] != STATUS_OK) {
+				status = statuses[m];
+			} else if (cache) {
+				TBUnionCache::Pair &pair = cache->mPairs[next[missing[m]].key];
+				pair.operand = next[missing[m]].owned;
+				pair.generation = cache->mGeneration;
+				cache->mNumComputed++;
+			}
+		}
+		level.swap(next);
+	}
+
+	if (status == STATUS_OK) {
+		level[0].operand->toMesh(result);
+	}
+	if (cache) {
+		TBUnionCache::Map::iterator pair = cache->mPairs.begin();
+		while (pair != cache->mPairs.end()) {
+			if (pair->second.generation < cache->mGeneration - 1) {
+				pair = cache->mPairs.erase(pair);
+			} else {
+				++pair;
+			}
+		}
+		cache->mGeneration++;
+	}
+	return status;
+}
+
+TBBoolean::Status TBBoolean::addWithGts(const TBNativeOperand &a, const TBNativeOperand &b,
+										TBNativeOperand &result)
+{
+	// GTS is not thread safe and the pairs of a level run in parallel.
+	static std::mutex gtsMutex;
+	TBMesh meshA, meshB, united;
+	a.toMesh(meshA);
+	b.toMesh(meshB);
+	Status status;
+	{
+		std::lock_guard<std::mutex> lock(gtsMutex);
+		status = add(meshA, meshB, united, ENGINE_GTS);
+	}
+	if (status == STATUS_OK) {
+		result.load(united);
+	}
+	return status;
+}
+
+TBUnionCache::TBUnionCache()
+	: mGeneration(0), mNumReused(0), mNumComputed(0)
+{
+}
+
+void TBUnionCache::clear()
+{
+	mPairs.clear();
+	mNumReused = 0;
+	mNumComputed = 0;
+}
+
+int TBUnionCache::getNumReused() const
+{
+	return mNumReused;
+}
+
+int TBUnionCache::getNumComputed() const
+{
+	return mNumComputed;
+}
+
+TBBoolean::Status TBBoolean::sub(const TBMesh &m1, const TBMesh &m2, TBMesh &result, Engine engine)
+{
+	TBBooleanResults results;
+	results.subtract = &result;
+	return compute(m1, m2, results, engine);
+}
+
+TBBoolean::Status TBBoolean::diff(const TBMesh &m1, const TBMesh &m2, TBMesh &result, Engine engine)
+{
+	TBBooleanResults results;
+	results.difference = &result;
+	return compute(m1, m2, results, engine);
+}
+
+TBBoolean::Status TBBoolean::compute(const TBMesh &m1, const TBMesh &m2, TBBooleanResults &results,
+									 Engine engine)
+{
+	// Part of each result taken from each class, and the classes that are
+	// written reversed because they bound the result from the other side.
+	static const int parts[4][2] = {
+		{ TBNativeBoolean::A_OUT_B | TBNativeBoolean::B_OUT_A, 0 },
+		{ TBNativeBoolean::A_OUT_B | TBNativeBoolean::B_IN_A, TBNativeBoolean::B_IN_A },
+		{ TBNativeBoolean::A_IN_B | TBNativeBoolean::B_IN_A, 0 },
+		{ TBNativeBoolean::A_OUT_B | TBNativeBoolean::B_OUT_A | TBNativeBoolean::A_IN_B | TBNativeBoolean::B_IN_A,
+		  TBNativeBoolean::A_IN_B | TBNativeBoolean::B_IN_A }
+	};
+	TBMesh *outputs[4] = { results.unite, results.subtract, results.intersect, results.difference };
+
+	TBBooleanOperand o1(m1);
+	TBBooleanOperand o2(m2);
+	Status status = check(o1);
+	if (status == STATUS_OK) {
+		status = check(o2);
+	}
+	if (status != STATUS_OK) {
+		return status;
+	}
+
+	// Pairs the native engine leaves unresolved go to GTS.
+	if (engine == ENGINE_NATIVE) {
+		TBNativeBoolean boolean(o1.getNative(), o2.getNative());
+		if (boolean.isResolved()) {
+			for (int r=0; r<4; r++) {
+				if (outputs[r]) {
+					boolean.collect(parts[r][0], parts[r][1], *outputs[r]);
+				}
+			}
+			return STATUS_OK;
+		}
+	}
+
+	// getTree() sets mIsOpen, so the trees are built before the flags are
+	// read; argument evaluation order is unspecified.
+	GtsSurface *s1 = o1.getSurface();
+	GtsSurface *s2 = o2.getSurface();
+	GNode *tree1 = o1.getTree();
+	GNode *tree2 = o2.getTree();
+
+	/* boolean surface */
+	GtsSurfaceInter *si = gts_surface_inter_new (gts_surface_inter_class (),
+				s1, s2, tree1, tree2, o1.mIsOpen, o2.mIsOpen);
+
+	// Each class is extracted once; faces are shared between surfaces, so
+	// reversed copies are made while converting instead of reverting them.
+	static const GtsBooleanOperation classes[4] = { GTS_1_OUT_2, GTS_1_IN_2, GTS_2_OUT_1, GTS_2_IN_1 };
+	static const int classParts[4] = { TBNativeBoolean::A_OUT_B, TBNativeBoolean::A_IN_B,
+									   TBNativeBoolean::B_OUT_A, TBNativeBoolean::B_IN_A };
+	for (int c=0; c<4; c++) {
+		bool used = false;
+		for (int r=0; r<4; r++) {
+			used = used || (outputs[r] && (parts[r][0] & classParts[c]));
+		}
+		if (!used) {
+			continue;
+		}
+
+		GtsSurface * part = gts_surface_new (gts_surface_class (),
+											 gts_face_class (),
+											 gts_edge_class (),
+											 gts_vertex_class ());
+		gts_surface_inter_boolean (si, part, classes[c]);
+		for (int r=0; r<4; r++) {
+			if (outputs[r] && (parts[r][0] & classParts[c])) {
+				tbMeshFromGtsSurface(part, *outputs[r], (parts[r][1] & classParts[c]) != 0);
+			}
+		}
+		gts_object_destroy (GTS_OBJECT (part));
+	}
+
+	gts_object_destroy (GTS_OBJECT (si));
+	return STATUS_OK;
 }
 
 void TBBoolean::testMeshConvert(const TBMesh &mesh, TBMesh &result)
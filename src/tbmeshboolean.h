@@ -1,16 +1,186 @@
 #ifndef _TBMESHBOOLEAN_
 #define _TBMESHBOOLEAN_
 
+#include <memory>
+#include <unordered_map>
 #include "tbmesh.h"
 
+typedef struct _GtsSurface GtsSurface;
+typedef struct _GNode GNode;
+struct TBNativeOperand;
+class TBBooleanOperand;
+class TBUnionCache;
+
+// Outputs of TBBoolean::compute. Null members are skipped, the others are
+// appended to.
+struct TBBooleanResults
+{
+	TBMesh *unite;
+	TBMesh *subtract;
+	TBMesh *intersect;
+	TBMesh *difference;
+
+	TBBooleanResults() : unite(NULL), subtract(NULL), intersect(NULL), difference(NULL) {}
+};
+
 class TBBoolean
 {
 public:
-	static void add(const TBMesh &m1, const TBMesh &m2, TBMesh &result);
-	static void sub(const TBMesh &m1, const TBMesh &m2, TBMesh &result);
-	static void diff(const TBMesh &m1, const TBMesh &m2, TBMesh &result);
+	enum Engine
+	{
+		// Exact-ish double precision engine working on the index buffers.
+		// Operations it cannot resolve, such as coplanar overlaps, are
+		// redone with GTS.
+		ENGINE_NATIVE,
+		// Round trip through GTS; slower, kept as a reference.
+		ENGINE_GTS
+	};
+
+	// How much each operand is checked before it is used. Every operand is
+	// checked once; boolean results are trusted.
+	enum Validation
+	{
+		VALIDATE_NONE,
+		// Closed, manifold and consistently oriented, from the index buffer.
+		VALIDATE_MANIFOLD,
+		// Also free of self intersections, tested with the operand's BVH.
+		VALIDATE_FULL
+	};
+
+	enum Status
+	{
+		STATUS_OK,
+		// A triangle uses the same vertex twice.
+		STATUS_DEGENERATE,
+		// An edge has a single triangle.
+		STATUS_OPEN,
+		// An edge has more than two triangles.
+		STATUS_NON_MANIFOLD,
+		// Two triangles run along their shared edge in the same direction.
+		STATUS_NOT_ORIENTED,
+		STATUS_SELF_INTERSECTING
+	};
+
+	// Defaults to VALIDATE_MANIFOLD.
+	static void setValidation(Validation validation);
+	static Validation getValidation();
+	static Status validate(const TBMesh &mesh, Validation validation);
+	static const char *getStatusName(Status status);
+
+	// The operations leave result untouched when an operand fails validation
+	// and return the failure.
+	static Status add(const TBMesh &m1, const TBMesh &m2, TBMesh &result,
+					  Engine engine = ENGINE_NATIVE);
+	static Status add(const TBBooleanOperand &m1, const TBBooleanOperand &m2,
+					  TBBooleanOperand &result, Engine engine = ENGINE_NATIVE);
+	// Union of any number of meshes, appended to result. Operands are
+	// ordered spatially and reduced pairwise in a balanced tree; pairs whose
+	// bounding boxes are disjoint are concatenated without intersecting them
+	// and the pairs of each level run on the shared thread pool. The GTS
+	// engine is not thread safe and folds the operands serially.
+	static Status unionAll(const std::vector<const TBMesh *> &meshes, TBMesh &result,
+						   Engine engine = ENGINE_NATIVE);
+	// Native union of operands the caller has loaded and validated. keys[i]
+	// stands for whatever operand i was made from; the pairs of the tree
+	// are kept in cache by their operands' keys, so a later union in which
+	// some operands changed takes every pair above unchanged ones from it.
+	static Status unionAll(const std::vector<const TBNativeOperand *> &operands,
+						   const std::vector<unsigned long long> &keys, TBUnionCache &cache,
+						   TBMesh &result);
+	// m1 minus m2.
+	static Status sub(const TBMesh &m1, const TBMesh &m2, TBMesh &result,
+					  Engine engine = ENGINE_NATIVE);
+	// Symmetric difference: the parts of either mesh outside the other. The
+	// two shells touch along the intersection curves.
+	static Status diff(const TBMesh &m1, const TBMesh &m2, TBMesh &result,
+					   Engine engine = ENGINE_NATIVE);
+	// Any combination of the above from a single intersection pass.
+	static Status compute(const TBMesh &m1, const TBMesh &m2, TBBooleanResults &results,
+						  Engine engine = ENGINE_NATIVE);
 
 	// Use for testing only.
 	static void testMeshConvert(const TBMesh &mesh, TBMesh &result);
+
+private:
+	static Status check(const TBBooleanOperand &operand);
+	static Status check(const TBNativeOperand &operand, Validation validation);
+	// Balanced reduction shared by the unionAll() overloads; keys and cache
+	// may be null.
+	static Status reduceUnion(const std::vector<const TBNativeOperand *> &operands,
+							  const unsigned long long *keys, TBUnionCache *cache, TBMesh &result);
+	// Union of a pair through GTS, for pairs the native engine leaves
+	// unresolved. Calls from several threads are serialized.
+	static Status addWithGts(const TBNativeOperand &a, const TBNativeOperand &b,
+							 TBNativeOperand &result);
+
+	static Validation sValidation;
+};
+
+// Boolean operand that keeps the engine specific data alive between
+// operations: the GTS surface with its bounding box tree and volume, or the
+// native operand with its BVH. Results are written to an operand as well,
+// so a chain of booleans converts each input once and never converts the
+// intermediate results back and forth through TBMesh.
+class TBBooleanOperand
+{
+public:
+	TBBooleanOperand();
+	explicit TBBooleanOperand(const TBMesh &mesh);
+	~TBBooleanOperand();
+
+	// Drops the cached data and shares the storage of mesh.
+	void setMesh(const TBMesh &mesh);
+	// Converted from the engine data on first use after a boolean.
+	const TBMesh &getMesh() const;
+
+private:
+	TBBooleanOperand(const TBBooleanOperand &);
+	TBBooleanOperand &operator=(const TBBooleanOperand &);
+
+	void clear();
+	GtsSurface *getSurface() const;
+	GNode *getTree() const;
+	const TBNativeOperand &getNative() const;
+
+	friend class TBBoolean;
+
+	mutable TBMesh *mMesh;
+	mutable GtsSurface *mSurface;
+	mutable GNode *mTree;
+	mutable bool mIsOpen;
+	mutable TBNativeOperand *mNative;
+
+	// Highest level checked so far and its outcome.
+	mutable TBBoolean::Validation mValidated;
+	mutable TBBoolean::Status mStatus;
+};
+
+// Intermediate results of the keyed TBBoolean::unionAll(). The pairs of
+// the last two unions are kept, so a union can go back to the operands of
+// the one before at no cost.
+class TBUnionCache
+{
+public:
+	TBUnionCache();
+
+	void clear();
+	// Pairs of the last union taken from the cache and computed.
+	int getNumReused() const;
+	int getNumComputed() const;
+
+private:
+	friend class TBBoolean;
+
+	struct Pair
+	{
+		std::shared_ptr<const TBNativeOperand> operand;
+		int generation;
+	};
+	typedef std::unordered_map<unsigned long long, Pair> Map;
+
+	Map mPairs;
+	int mGeneration;
+	int mNumReused;
+	int mNumComputed;
 };
-#endif
\ No newline at end of file
+#endif
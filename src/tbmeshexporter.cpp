@@ -0,0 +1,404 @@
+#include "tbmeshexporter.h"
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+
+namespace {
+
+// Largest record of any format: an OBJ vertex line with three 31
+// character numbers.
+const size_t MAX_RECORD = 128;
+const size_t MAX_HEADER = 256;
+const size_t STL_HEADER = 80;
+const size_t STL_TRIANGLE = 50;
+const size_t PLY_FACE = 1 + 3 * sizeof(int);
+
+const uint64_t POWERS_OF_TEN[10] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+	1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL
+};
+
+const char DIGIT_PAIRS[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+int countDigits(uint32_t value)
+{
+	int numDigits = 1;
+	for (uint32_t limit=10; numDigits<10 && value>=limit; limit*=10) {
+		numDigits++;
+	}
+	return numDigits;
+}
+
+// Writes the last numDigits digits of value, two at a time from the end.
+void formatDigits(char *out, uint32_t value, int numDigits)
+{
+	char *end = out + numDigits;
+	while (end - out >= 2) {
+		const char *pair = DIGIT_PAIRS + (value % 100) * 2;
+		value /= 100;
+		*--end = pair[1];
+		*--end = pair[0];
+	}
+	if (end != out) {
+		*--end = (char)('0' + value % 10);
+	}
+}
+
+char *formatUnsigned(char *out, uint64_t value)
+{
+	if (value > 0xffffffffULL) {
+		// Split in nine digit groups, which fit 32 bits.
+		out = formatUnsigned(out, value / 1000000000ULL);
+		formatDigits(out, (uint32_t)(value % 1000000000ULL), 9);
+		return out + 9;
+	}
+	int numDigits = countDigits((uint32_t)value);
+	formatDigits(out, (uint32_t)value, numDigits);
+	return out + numDigits;
+}
+
+// Rounds to the given decimals and drops trailing zeros. Values too large
+// for the fixed point form, infinities and NaNs go through snprintf.
+char *formatFloat(char *out, float value, int decimals)
+{
+	double magnitude = fabs((double)value);
+	double scaled = magnitude * (double)POWERS_OF_TEN[decimals] + 0.5;
+	if (!(scaled < 9.0e18)) {
+		return out + snprintf(out, 32, "%.9g", value);
+	}
+
+	uint64_t fixed = (uint64_t)scaled;
+	if (value < 0.0f && fixed != 0) {
+		*out++ = '-';
+	}
+	uint64_t unit = POWERS_OF_TEN[decimals];
+	out = formatUnsigned(out, fixed / unit);
+	uint32_t fraction = (uint32_t)(fixed % unit);
+	if (fraction) {
+		*out++ = '.';
+		formatDigits(out, fraction, decimals);
+		out += decimals;
+		while (out[-1] == '0') {
+			out--;
+		}
+	}
+	return out;
+}
+
+char *writeFloats(char *out, const float *values, int count)
+{
+	memcpy(out, values, count * sizeof(float));
+	return out + count * sizeof(float);
+}
+
+}
+
+const char *TBMeshExporter::getStatusName(Status status)
+{
+	switch (status) {
+		case STATUS_OK: return "ok";
+		case STATUS_OPEN_FAILED: return "cannot open the file";
+		case STATUS_WRITE_FAILED: return "cannot write the file";
+		case STATUS_UNKNOWN_FORMAT: return "unknown mesh format";
+	}
+	return "unknown";
+}
+
+bool TBMeshExporter::getFormat(const char *path, Format &format)
+{
+	const char *dot = strrchr(path, '.');
+	if (!dot || strlen(dot) != 4) {
+		return false;
+	}
+	char extension[4];
+	for (int i=0; i<3; i++) {
+		extension[i] = (char)tolower((unsigned char)dot[i + 1]);
+	}
+	extension[3] = '\0';
+
+	if (strcmp(extension, "stl") == 0) {
+		format = FORMAT_STL;
+	} else if (strcmp(extension, "ply") == 0) {
+		format = FORMAT_PLY;
+	} else if (strcmp(extension, "obj") == 0) {
+		format = FORMAT_OBJ;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+TBMeshExporter::Status TBMeshExporter::save(const char *path, const TBMesh &mesh)
+{
+	Format format;
+	if (!getFormat(path, format)) {
+		return STATUS_UNKNOWN_FORMAT;
+	}
+	TBMeshExporter exporter;
+	Status status = exporter.open(path, format);
+	if (status != STATUS_OK) {
+		return status;
+	}
+	exporter.write(mesh);
+	return exporter.close();
+}
+
+TBMeshExporter::TBMeshExporter(size_t bufferSize)
+	: mFormat(FORMAT_STL), mFile(NULL), mSpool(NULL), mDecimals(6),
+	  mNumVertices(0), mNumTriangles(0), mFailed(false),
+	  mBuffer(bufferSize < MAX_HEADER ? MAX_HEADER : bufferSize), mPending(mBuffer.size()),
+	  mUsed(0), mPendingSize(0), mSpoolUsed(0),
+	  mHasPending(false), mStopping(false), mWriteFailed(false)
+{
+}
+
+TBMeshExporter::~TBMeshExporter()
+{
+	close();
+}
+
+void TBMeshExporter::setDecimals(int decimals)
+{
+	mDecimals = decimals < 0 ? 0 : (decimals > 9 ? 9 : decimals);
+}
+
+TBMeshExporter::Status TBMeshExporter::open(const char *path, Format format)
+{
+	close();
+
+	mFile = fopen(path, "wb");
+	if (!mFile) {
+		return STATUS_OPEN_FAILED;
+	}
+	// The buffers are already large; stdio would only copy them again.
+	setvbuf(mFile, NULL, _IONBF, 0);
+	if (format == FORMAT_PLY) {
+		mSpool = tmpfile();
+		if (!mSpool) {
+			fclose(mFile);
+			mFile = NULL;
+			return STATUS_OPEN_FAILED;
+		}
+		mSpoolBuffer.resize(mBuffer.size());
+		mSpoolUsed = 0;
+	}
+
+	mFormat = format;
+	mNumVertices = 0;
+	mNumTriangles = 0;
+	mFailed = false;
+	mUsed = 0;
+	mHasPending = false;
+	mStopping = false;
+	mWriteFailed = false;
+	mWriter = std::thread(&TBMeshExporter::runWriter, this);
+
+	// Written again with the counts by close().
+	writeHeader();
+	return STATUS_OK;
+}
+
+void TBMeshExporter::write(const Vector3f *vertices, int numVertices, const int *indices, int numIndices)
+{
+	assertion(mFile != NULL, "No export is open.\n");
+
+	int numTriangles = numIndices / 3;
+	if (mFormat == FORMAT_STL) {
+		for (int t=0; t<numTriangles; t++) {
+			const Vector3f &v0 = vertices[indices[t*3]];
+			const Vector3f &v1 = vertices[indices[t*3 + 1]];
+			const Vector3f &v2 = vertices[indices[t*3 + 2]];
+			Vector3f normal = (v1 - v0).Cross(v2 - v0);
+			float length = normal.Length();
+			if (length > 0.0f) {
+				normal /= length;
+			}
+			char *out = reserve(STL_TRIANGLE);
+			out = writeFloats(out, (const float *)normal, 3);
+			out = writeFloats(out, (const float *)v0, 3);
+			out = writeFloats(out, (const float *)v1, 3);
+			out = writeFloats(out, (const float *)v2, 3);
+			out[0] = out[1] = 0;
+			mUsed += STL_TRIANGLE;
+		}
+	} else if (mFormat == FORMAT_PLY) {
+		for (int i=0; i<numVertices; i++) {
+			writeFloats(reserve(3 * sizeof(float)), (const float *)vertices[i], 3);
+			mUsed += 3 * sizeof(float);
+		}
+		for (int t=0; t<numTriangles; t++) {
+			if (mSpoolUsed + PLY_FACE > mSpoolBuffer.size()) {
+				mFailed |= fwrite(&mSpoolBuffer[0], 1, mSpoolUsed, mSpool) != mSpoolUsed;
+				mSpoolUsed = 0;
+			}
+			char *out = &mSpoolBuffer[mSpoolUsed];
+			*out++ = 3;
+			for (int k=0; k<3; k++) {
+				int index = mNumVertices + indices[t*3 + k];
+				memcpy(out, &index, sizeof(int));
+				out += sizeof(int);
+			}
+			mSpoolUsed += PLY_FACE;
+		}
+	} else {
+		for (int i=0; i<numVertices; i++) {
+			char *start = reserve(MAX_RECORD);
+			char *out = start;
+			*out++ = 'v';
+			for (int k=0; k<3; k++) {
+				*out++ = ' ';
+				out = formatFloat(out, vertices[i][k], mDecimals);
+			}
+			*out++ = '\n';
+			mUsed += out - start;
+		}
+		for (int t=0; t<numTriangles; t++) {
+			char *start = reserve(MAX_RECORD);
+			char *out = start;
+			*out++ = 'f';
+			for (int k=0; k<3; k++) {
+				*out++ = ' ';
+				out = formatUnsigned(out, (uint64_t)mNumVertices + indices[t*3 + k] + 1);
+			}
+			*out++ = '\n';
+			mUsed += out - start;
+		}
+	}
+
+	mNumVertices += numVertices;
+	mNumTriangles += numTriangles;
+}
+
+void TBMeshExporter::write(const TBMesh &mesh)
+{
+	const std::vector<Vector3f> &vertices = mesh.getVertices();
+	const std::vector<int> &indices = mesh.getIndices();
+	if (!indices.empty()) {
+		write(&vertices[0], vertices.size(), &indices[0], indices.size());
+	}
+}
+
+TBMeshExporter::Status TBMeshExporter::close()
+{
+	if (!mFile) {
+		return STATUS_OK;
+	}
+
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mCondition.notify_all();
+	mWriter.join();
+
+	bool written = !mFailed && !mWriteFailed;
+	if (mFormat == FORMAT_PLY) {
+		written = written && appendSpool();
+		fclose(mSpool);
+		mSpool = NULL;
+	}
+	if (mFormat != FORMAT_OBJ) {
+		// The header has the same size with the final counts.
+		written = written && fseek(mFile, 0, SEEK_SET) == 0 && writeHeader();
+	}
+	written = fclose(mFile) == 0 && written;
+	mFile = NULL;
+	return written ? STATUS_OK : STATUS_WRITE_FAILED;
+}
+
+bool TBMeshExporter::writeHeader()
+{
+	char header[MAX_HEADER];
+	size_t size = 0;
+	if (mFormat == FORMAT_STL) {
+		// Readers take a header starting with "solid" for ASCII STL.
+		memset(header, ' ', STL_HEADER);
+		memcpy(header, "TurbGiz binary STL", 18);
+		memcpy(header + STL_HEADER, &mNumTriangles, sizeof(mNumTriangles));
+		size = STL_HEADER + sizeof(mNumTriangles);
+	} else if (mFormat == FORMAT_PLY) {
+		// Fixed width counts keep the header size. The blocks are written
+		// in host order, which is little endian on the supported targets.
+		size = snprintf(header, MAX_HEADER,
+						"ply\n"
+						"format binary_little_endian 1.0\n"
+						"element vertex %-10u\n"
+						"property float x\n"
+						"property float y\n"
+						"property float z\n"
+						"element face %-10u\n"
+						"property list uchar int vertex_indices\n"
+						"end_header\n",
+						mNumVertices, mNumTriangles);
+	}
+	if (size == 0) {
+		return true;
+	}
+	if (mWriter.joinable()) {
+		memcpy(reserve(size), header, size);
+		mUsed += size;
+		return true;
+	}
+	return fwrite(header, 1, size, mFile) == size;
+}
+
+bool TBMeshExporter::appendSpool()
+{
+	if (fwrite(&mSpoolBuffer[0], 1, mSpoolUsed, mSpool) != mSpoolUsed || fflush(mSpool) != 0) {
+		return false;
+	}
+	rewind(mSpool);
+	size_t size;
+	while ((size = fread(&mBuffer[0], 1, mBuffer.size(), mSpool)) > 0) {
+		if (fwrite(&mBuffer[0], 1, size, mFile) != size) {
+			return false;
+		}
+	}
+	return !ferror(mSpool);
+}
+
+char *TBMeshExporter::reserve(size_t size)
+{
+	if (mUsed + size > mBuffer.size()) {
+		flush();
+	}
+	return &mBuffer[mUsed];
+}
+
+void TBMeshExporter::flush()
+{
+	if (mUsed == 0) {
+		return;
+	}
+	std::unique_lock<std::mutex> lock(mMutex);
+	mCondition.wait(lock, [this] { return !mHasPending; });
+	mBuffer.swap(mPending);
+	mPendingSize = mUsed;
+	mHasPending = true;
+	lock.unlock();
+	mCondition.notify_all();
+	mUsed = 0;
+}
+
+void TBMeshExporter::runWriter()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	for (;;) {
+		mCondition.wait(lock, [this] { return mHasPending || mStopping; });
+		if (!mHasPending) {
+			return;
+		}
+		// The caller only touches mPending again once it is released.
+		lock.unlock();
+		bool written = fwrite(&mPending[0], 1, mPendingSize, mFile) == mPendingSize;
+		lock.lock();
+		mWriteFailed |= !written;
+		mHasPending = false;
+		mCondition.notify_all();
+	}
+}
@@ -0,0 +1,97 @@
+#ifndef TBMESHEXPORTER_H
+#define TBMESHEXPORTER_H
+
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "tbmesh.h"
+
+// Streams triangle meshes to binary STL, binary PLY or Wavefront OBJ.
+//
+// Records are formatted straight into a large buffer, numbers by hand
+// without iostreams or allocations. A full buffer is handed to a writer
+// thread and formatting goes on in a second one, so the disk and the
+// formatting overlap. The mesh comes in chunks that may be written while
+// the rest is still being generated; the counts the STL and PLY headers
+// need are patched in by close(), and PLY faces, which must follow all
+// the vertices, are spooled to a temporary file until then.
+class TBMeshExporter
+{
+public:
+	enum Format
+	{
+		FORMAT_STL,
+		FORMAT_PLY,
+		FORMAT_OBJ
+	};
+
+	enum Status
+	{
+		STATUS_OK,
+		STATUS_OPEN_FAILED,
+		STATUS_WRITE_FAILED,
+		// The path has no .stl, .ply or .obj extension.
+		STATUS_UNKNOWN_FORMAT
+	};
+
+	static const char *getStatusName(Status status);
+	// From the extension of path, in any case.
+	static bool getFormat(const char *path, Format &format);
+	// Writes the whole mesh in the format of the path's extension.
+	static Status save(const char *path, const TBMesh &mesh);
+
+	explicit TBMeshExporter(size_t bufferSize = 4 << 20);
+	~TBMeshExporter();
+
+	// Closes any open export first.
+	Status open(const char *path, Format format);
+	// OBJ coordinates are rounded to this many decimals; 6 by default.
+	void setDecimals(int decimals);
+
+	// Appends a chunk whose indices refer to its own vertices. STL only
+	// needs the triangles, so its vertices are not kept between chunks.
+	void write(const Vector3f *vertices, int numVertices, const int *indices, int numIndices);
+	// The vertices are written with the mesh transform applied.
+	void write(const TBMesh &mesh);
+
+	// Completes the file. Write errors are kept until here.
+	Status close();
+
+private:
+	TBMeshExporter(const TBMeshExporter &);
+	TBMeshExporter &operator=(const TBMeshExporter &);
+
+	// Room for size more bytes in the fill buffer.
+	char *reserve(size_t size);
+	void flush();
+	void runWriter();
+	bool writeHeader();
+	bool appendSpool();
+
+	Format mFormat;
+	FILE *mFile;
+	FILE *mSpool;
+	int mDecimals;
+	unsigned int mNumVertices;
+	unsigned int mNumTriangles;
+	bool mFailed;
+
+	// mBuffer is filled by the caller while mPending is being written.
+	std::vector<char> mBuffer;
+	std::vector<char> mPending;
+	size_t mUsed;
+	size_t mPendingSize;
+	std::vector<char> mSpoolBuffer;
+	size_t mSpoolUsed;
+
+	std::thread mWriter;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mHasPending;
+	bool mStopping;
+	bool mWriteFailed;
+};
+
+#endif
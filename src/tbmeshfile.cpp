@@ -0,0 +1,301 @@
+#include "tbmeshfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static_assert(sizeof(Vector3f) == 3 * sizeof(float), "Vector3f blocks are mapped as packed floats.");
+
+namespace {
+
+const char MAGIC[4] = { 'T', 'B', 'M', 'F' };
+const uint64_t BLOCK_ALIGNMENT = 64;
+
+uint64_t alignBlock(uint64_t offset)
+{
+	return (offset + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+}
+
+// Pads with zeros up to offset, then writes the block.
+bool writeBlock(FILE *file, uint64_t &position, uint64_t offset, const void *data, size_t size)
+{
+	static const char zeros[BLOCK_ALIGNMENT] = { 0 };
+	if (fwrite(zeros, 1, offset - position, file) != offset - position ||
+		fwrite(data, 1, size, file) != size) {
+		return false;
+	}
+	position = offset + size;
+	return true;
+}
+
+}
+
+const uint32_t TBMeshFile::VERSION;
+const uint32_t TBMeshFile::FLAG_NORMALS;
+
+const char *TBMeshFile::getStatusName(Status status)
+{
+	switch (status) {
+		case STATUS_OK: return "ok";
+		case STATUS_OPEN_FAILED: return "cannot open the file";
+		case STATUS_WRITE_FAILED: return "cannot write the file";
+		case STATUS_TRUNCATED: return "truncated file";
+		case STATUS_BAD_HEADER: return "not a mesh file of this version";
+		case STATUS_BAD_LAYOUT: return "corrupt block layout";
+		case STATUS_BAD_CHECKSUM: return "checksum mismatch";
+		case STATUS_BAD_INDEX: return "index out of range";
+	}
+	return "unknown";
+}
+
+uint64_t TBMeshFile::computeChecksum(const void *data, size_t size, uint64_t seed)
+{
+	const uint64_t prime = 1099511628211ULL;
+	const unsigned char *bytes = (const unsigned char *)data;
+	uint64_t hash = seed;
+	size_t numWords = size / 4;
+	for (size_t i=0; i<numWords; i++) {
+		uint32_t word;
+		memcpy(&word, bytes + i * 4, 4);
+		hash = (hash ^ word) * prime;
+	}
+	for (size_t i=numWords*4; i<size; i++) {
+		hash = (hash ^ bytes[i]) * prime;
+	}
+	return hash;
+}
+
+TBMeshFile::Status TBMeshFile::save(const char *path, const Vector3f *vertices, const Vector3f *normals,
+									int numVertices, const int *indices, int numIndices)
+{
+	TBMeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.flags = normals ? FLAG_NORMALS : 0;
+	header.numVertices = numVertices;
+	header.numIndices = numIndices;
+
+	size_t vertexBytes = numVertices * sizeof(Vector3f);
+	size_t indexBytes = numIndices * sizeof(int);
+	header.vertexOffset = alignBlock(sizeof(header));
+	uint64_t end = header.vertexOffset + vertexBytes;
+	if (normals) {
+		header.normalOffset = alignBlock(end);
+		end = header.normalOffset + vertexBytes;
+	}
+	header.indexOffset = alignBlock(end);
+	header.fileSize = header.indexOffset + indexBytes;
+
+	header.checksum = computeChecksum(vertices, vertexBytes);
+	if (normals) {
+		header.checksum = computeChecksum(normals, vertexBytes, header.checksum);
+	}
+	header.checksum = computeChecksum(indices, indexBytes, header.checksum);
+
+	for (int k=0; k<3; k++) {
+		header.boundsMin[k] = numVertices > 0 ? vertices[0][k] : 0.0f;
+		header.boundsMax[k] = header.boundsMin[k];
+	}
+	for (int i=1; i<numVertices; i++) {
+		for (int k=0; k<3; k++) {
+			float value = vertices[i][k];
+			if (value < header.boundsMin[k]) {
+				header.boundsMin[k] = value;
+			} else if (value > header.boundsMax[k]) {
+				header.boundsMax[k] = value;
+			}
+		}
+	}
+
+	// A temporary of its own in the same directory, so writers saving the
+	// same path at once never share one, and the rename stays atomic.
+	std::string temporary = std::string(path) + ".XXXXXX";
+	int descriptor = mkstemp(&temporary[0]);
+	if (descriptor < 0) {
+		return STATUS_OPEN_FAILED;
+	}
+	fchmod(descriptor, 0644);
+	FILE *file = fdopen(descriptor, "wb");
+	if (!file) {
+		::close(descriptor);
+		remove(temporary.c_str());
+		return STATUS_OPEN_FAILED;
+	}
+	uint64_t position = 0;
+	bool written = writeBlock(file, position, 0, &header, sizeof(header)) &&
+				   writeBlock(file, position, header.vertexOffset, vertices, vertexBytes) &&
+				   (!normals || writeBlock(file, position, header.normalOffset, normals, vertexBytes)) &&
+				   writeBlock(file, position, header.indexOffset, indices, indexBytes);
+	written = fclose(file) == 0 && written;
+	if (!written || rename(temporary.c_str(), path) != 0) {
+		remove(temporary.c_str());
+		return STATUS_WRITE_FAILED;
+	}
+	return STATUS_OK;
+}
+
+TBMeshFile::Status TBMeshFile::save(const char *path, const TBMesh &mesh)
+{
+	const std::vector<Vector3f> &vertices = mesh.getVertices();
+	const std::vector<int> &indices = mesh.getIndices();
+	return save(path, vertices.empty() ? NULL : &vertices[0], NULL, vertices.size(),
+				indices.empty() ? NULL : &indices[0], indices.size());
+}
+
+TBMeshFile::TBMeshFile()
+	: mData(NULL), mSize(0)
+{
+}
+
+TBMeshFile::~TBMeshFile()
+{
+	close();
+}
+
+TBMeshFile::Status TBMeshFile::open(const char *path)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return STATUS_OPEN_FAILED;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		::close(fd);
+		return STATUS_OPEN_FAILED;
+	}
+	size_t size = info.st_size;
+	if (size < sizeof(TBMeshFileHeader)) {
+		::close(fd);
+		return STATUS_TRUNCATED;
+	}
+	// The mapping keeps the file alive, so the descriptor is not needed.
+	void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		return STATUS_OPEN_FAILED;
+	}
+	mData = (const char *)data;
+	mSize = size;
+
+	// Only the header page is read here.
+	const TBMeshFileHeader &header = getHeader();
+	Status status = STATUS_OK;
+	uint64_t vertexBytes = (uint64_t)header.numVertices * sizeof(Vector3f);
+	uint64_t indexBytes = (uint64_t)header.numIndices * sizeof(int);
+	bool hasNormals = (header.flags & FLAG_NORMALS) != 0;
+	uint64_t vertexEnd = header.vertexOffset + vertexBytes;
+	uint64_t normalEnd = hasNormals ? header.normalOffset + vertexBytes : vertexEnd;
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+		status = STATUS_BAD_HEADER;
+	} else if (header.fileSize > size) {
+		status = STATUS_TRUNCATED;
+	} else if (header.vertexOffset > header.fileSize || header.normalOffset > header.fileSize ||
+			   header.indexOffset > header.fileSize ||
+			   header.numVertices > (uint32_t)0x7fffffff || header.numIndices > (uint32_t)0x7fffffff ||
+			   header.numIndices % 3 != 0 ||
+			   header.vertexOffset % BLOCK_ALIGNMENT != 0 || header.normalOffset % BLOCK_ALIGNMENT != 0 ||
+			   header.indexOffset % BLOCK_ALIGNMENT != 0 ||
+			   header.vertexOffset < sizeof(TBMeshFileHeader) ||
+			   (hasNormals ? header.normalOffset < vertexEnd : header.normalOffset != 0) ||
+			   header.indexOffset < normalEnd ||
+			   header.indexOffset + indexBytes > header.fileSize) {
+		status = STATUS_BAD_LAYOUT;
+	}
+	if (status != STATUS_OK) {
+		close();
+	}
+	return status;
+}
+
+void TBMeshFile::close()
+{
+	if (mData) {
+		munmap((void *)mData, mSize);
+		mData = NULL;
+		mSize = 0;
+	}
+}
+
+bool TBMeshFile::isOpen() const
+{
+	return mData != NULL;
+}
+
+TBMeshFile::Status TBMeshFile::verify() const
+{
+	assertion(isOpen(), "No mesh file is open.\n");
+
+	const TBMeshFileHeader &header = getHeader();
+	size_t vertexBytes = header.numVertices * sizeof(Vector3f);
+	uint64_t checksum = computeChecksum(getVertices(), vertexBytes);
+	if (getNormals()) {
+		checksum = computeChecksum(getNormals(), vertexBytes, checksum);
+	}
+	checksum = computeChecksum(getIndices(), header.numIndices * sizeof(int), checksum);
+	if (checksum != header.checksum) {
+		return STATUS_BAD_CHECKSUM;
+	}
+
+	const int *indices = getIndices();
+	for (uint32_t i=0; i<header.numIndices; i++) {
+		if ((uint32_t)indices[i] >= header.numVertices) {
+			return STATUS_BAD_INDEX;
+		}
+	}
+	return STATUS_OK;
+}
+
+const TBMeshFileHeader &TBMeshFile::getHeader() const
+{
+	return *(const TBMeshFileHeader *)mData;
+}
+
+int TBMeshFile::getNumVertices() const
+{
+	return getHeader().numVertices;
+}
+
+int TBMeshFile::getNumIndices() const
+{
+	return getHeader().numIndices;
+}
+
+const Vector3f *TBMeshFile::getVertices() const
+{
+	return (const Vector3f *)(mData + getHeader().vertexOffset);
+}
+
+const Vector3f *TBMeshFile::getNormals() const
+{
+	const TBMeshFileHeader &header = getHeader();
+	return (header.flags & FLAG_NORMALS) ? (const Vector3f *)(mData + header.normalOffset) : NULL;
+}
+
+const int *TBMeshFile::getIndices() const
+{
+	return (const int *)(mData + getHeader().indexOffset);
+}
+
+Vector3f TBMeshFile::getBoundsMin() const
+{
+	const float *bounds = getHeader().boundsMin;
+	return Vector3f(bounds[0], bounds[1], bounds[2]);
+}
+
+Vector3f TBMeshFile::getBoundsMax() const
+{
+	const float *bounds = getHeader().boundsMax;
+	return Vector3f(bounds[0], bounds[1], bounds[2]);
+}
+
+void TBMeshFile::appendTo(TBMesh &mesh) const
+{
+	mesh.appendIndexed(getVertices(), getNumVertices(), getIndices(), getNumIndices());
+}
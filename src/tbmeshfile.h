@@ -0,0 +1,105 @@
+#ifndef TBMESHFILE_H
+#define TBMESHFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tbmesh.h"
+
+// Header of a binary mesh file. Every block starts on a 64 byte boundary
+// and is stored in native byte order, so a mapped file is used in place.
+struct TBMeshFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t numVertices;
+	uint32_t numIndices;
+	uint32_t reserved;
+	// Byte offsets from the start of the file; normalOffset is 0 without
+	// normals.
+	uint64_t vertexOffset;
+	uint64_t normalOffset;
+	uint64_t indexOffset;
+	uint64_t fileSize;
+	// computeChecksum() of the vertex, normal and index blocks in turn.
+	uint64_t checksum;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+// Memory mapped view of a binary mesh file.
+//
+// open() maps the file read only and checks the header and the block
+// layout, without reading the blocks: the vertex, normal and index
+// pointers point straight into the mapped pages, which are only faulted in
+// when they are used. verify() reads the whole file once to check the
+// checksum and the indices.
+class TBMeshFile
+{
+public:
+	enum Status
+	{
+		STATUS_OK,
+		STATUS_OPEN_FAILED,
+		STATUS_WRITE_FAILED,
+		// Shorter than its header or than the size it records.
+		STATUS_TRUNCATED,
+		// Not a mesh file, or written with another version or byte order.
+		STATUS_BAD_HEADER,
+		// Blocks overlapping, misaligned or outside the file.
+		STATUS_BAD_LAYOUT,
+		STATUS_BAD_CHECKSUM,
+		// An index refers past the last vertex.
+		STATUS_BAD_INDEX
+	};
+
+	static const uint32_t VERSION = 1;
+	static const uint32_t FLAG_NORMALS = 1;
+
+	static const char *getStatusName(Status status);
+
+	// Writes to a temporary file renamed over path when complete, so
+	// readers never map a partial file. Normals are optional.
+	static Status save(const char *path, const Vector3f *vertices, const Vector3f *normals,
+					   int numVertices, const int *indices, int numIndices);
+	// The vertices are written with the mesh transform applied.
+	static Status save(const char *path, const TBMesh &mesh);
+
+	// 64 bit FNV-1a over 32 bit words, chained through seed.
+	static uint64_t computeChecksum(const void *data, size_t size,
+									uint64_t seed = 14695981039346656037ULL);
+
+	TBMeshFile();
+	~TBMeshFile();
+
+	// Closes any mapped file first. On failure the view stays closed.
+	Status open(const char *path);
+	void close();
+	bool isOpen() const;
+
+	Status verify() const;
+
+	// The accessors are only valid while the file is open.
+	const TBMeshFileHeader &getHeader() const;
+	int getNumVertices() const;
+	int getNumIndices() const;
+	const Vector3f *getVertices() const;
+	// Null when the file has no normals.
+	const Vector3f *getNormals() const;
+	const int *getIndices() const;
+	Vector3f getBoundsMin() const;
+	Vector3f getBoundsMax() const;
+
+	// Appends the vertices and indices to mesh with one copy of each block
+	// and no welding.
+	void appendTo(TBMesh &mesh) const;
+
+private:
+	TBMeshFile(const TBMeshFile &);
+	TBMeshFile &operator=(const TBMeshFile &);
+
+	const char *mData;
+	size_t mSize;
+};
+
+#endif
@@ -0,0 +1,993 @@
+#include "tbnativeboolean.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+double orient3d(const Vector3d &a, const Vector3d &b, const Vector3d &c, const Vector3d &d)
+{
+	Vector3d ad = a - d;
+	Vector3d bd = b - d;
+	Vector3d cd = c - d;
+	return ad.Dot(bd.Cross(cd));
+}
+
+double orient2d(const double *a, const double *b, const double *c)
+{
+	return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+// Strict crossing of segment pq through the interior of triangle abc.
+bool segmentCrossesTriangle(const Vector3d &p, const Vector3d &q, const Vector3d &a,
+							const Vector3d &b, const Vector3d &c)
+{
+	double dp = orient3d(a, b, c, p);
+	double dq = orient3d(a, b, c, q);
+	if (!((dp > 0.0 && dq < 0.0) || (dp < 0.0 && dq > 0.0))) {
+		return false;
+	}
+	double e0 = orient3d(p, q, a, b);
+	double e1 = orient3d(p, q, b, c);
+	double e2 = orient3d(p, q, c, a);
+	return (e0 > 0.0 && e1 > 0.0 && e2 > 0.0) || (e0 < 0.0 && e1 < 0.0 && e2 < 0.0);
+}
+
+// Zero counts as negative everywhere, so that a point exactly on a plane or
+// a line always falls on the same side of it.
+int sign(double value)
+{
+	return value > 0.0 ? 1 : -1;
+}
+
+// Constrained triangulation of one input triangle in its own plane.
+//
+// The point count per triangle is small, so triangles are kept in a plain
+// array and neighbours are found by scanning it.
+class PlanarTriangulation
+{
+	public:
+		PlanarTriangulation(const std::vector<Vector3d> &points, int c0, int c1, int c2);
+
+		void insertPoint(int id);
+		// False if the segment could not be made an edge; it is then left out
+		// of curveEdges.
+		bool insertConstraint(int a, int b, std::unordered_set<unsigned long long> &curveEdges);
+		void getTriangles(std::vector<int> &triangles) const;
+
+	private:
+		int addLocal(int id);
+		int findLocal(int id) const;
+		int findTriangle(int a, int b) const;
+		bool hasEdge(int a, int b) const;
+		bool crosses(int a, int b, int u, int w) const;
+		void legalize(int tri, int edge);
+		bool flip(int tri, int edge);
+
+		static unsigned long long key(int a, int b);
+
+	private:
+		const std::vector<Vector3d> &mPoints;
+		int mAxis0, mAxis1;
+		double mEpsilon;
+		std::vector<int> mIds;
+		std::vector<double> mXY;
+		std::vector<int> mAlias;
+		std::vector<int> mTris;
+};
+
+PlanarTriangulation::PlanarTriangulation(const std::vector<Vector3d> &points,
+										 int c0, int c1, int c2)
+	: mPoints(points)
+{
+	// Drop the dominant axis of the normal, keeping the corners counter
+	// clockwise in the projection.
+	Vector3d normal = (points[c1] - points[c0]).Cross(points[c2] - points[c0]);
+	int drop = 0;
+	for (int k=1; k<3; k++) {
+		if (std::fabs(normal[k]) > std::fabs(normal[drop])) {
+			drop = k;
+		}
+	}
+	mAxis0 = (drop + 1) % 3;
+	mAxis1 = (drop + 2) % 3;
+	if (normal[drop] < 0.0) {
+		std::swap(mAxis0, mAxis1);
+	}
+
+	addLocal(c0);
+	addLocal(c1);
+	addLocal(c2);
+	mTris.push_back(0);
+	mTris.push_back(1);
+	mTris.push_back(2);
+
+	double area = std::fabs(orient2d(&mXY[0], &mXY[2], &mXY[4]));
+	mEpsilon = 1e-10 * (area > 0.0 ? area : 1.0);
+}
+
+unsigned long long PlanarTriangulation::key(int a, int b)
+{
+	if (a > b) {
+		std::swap(a, b);
+	}
+	return ((unsigned long long)(unsigned int)a << 32) | (unsigned int)b;
+}
+
+int PlanarTriangulation::addLocal(int id)
+{
+	mIds.push_back(id);
+	mXY.push_back(mPoints[id][mAxis0]);
+	mXY.push_back(mPoints[id][mAxis1]);
+	mAlias.push_back(mIds.size() - 1);
+	return mIds.size() - 1;
+}
+
+int PlanarTriangulation::findLocal(int id) const
+{
+	for (int i=0; i<(int)mIds.size(); i++) {
+		if (mIds[i] == id) {
+			return mAlias[i];
+		}
+	}
+	return -1;
+}
+
+void PlanarTriangulation::insertPoint(int id)
+{
+	if (findLocal(id) >= 0) {
+		return;
+	}
+	int p = addLocal(id);
+	const double *xy = &mXY[p*2];
+
+	// Locate the triangle the point is deepest inside of.
+	int best = -1;
+	double bestDepth = 0.0;
+	double bestWeights[3] = { 0.0, 0.0, 0.0 };
+	int numTris = mTris.size() / 3;
+	for (int t=0; t<numTris; t++) {
+		const int *v = &mTris[t*3];
+		double w[3];
+		double area = orient2d(&mXY[v[0]*2], &mXY[v[1]*2], &mXY[v[2]*2]);
+		if (area <= 0.0) {
+			continue;
+		}
+		for (int k=0; k<3; k++) {
+			w[k] = orient2d(&mXY[v[(k+1)%3]*2], &mXY[v[(k+2)%3]*2], xy) / area;
+		}
+		double depth = std::min(w[0], std::min(w[1], w[2]));
+		if (best < 0 || depth > bestDepth) {
+			best = t;
+			bestDepth = depth;
+			bestWeights[0] = w[0];
+			bestWeights[1] = w[1];
+			bestWeights[2] = w[2];
+		}
+	}
+	if (best < 0) {
+		return;
+	}
+
+	int v[3] = { mTris[best*3], mTris[best*3 + 1], mTris[best*3 + 2] };
+
+	// Points on a corner are merged into it.
+	for (int k=0; k<3; k++) {
+		if (bestWeights[k] > 1.0 - 1e-9) {
+			mAlias[p] = v[k];
+			return;
+		}
+	}
+
+	// Points on an edge split the triangles on both sides of it.
+	for (int k=0; k<3; k++) {
+		if (bestWeights[k] > 1e-9) {
+			continue;
+		}
+		int a = v[(k+1)%3];
+		int b = v[(k+2)%3];
+		int c = v[k];
+		int other = findTriangle(b, a);
+
+		mTris[best*3] = c;
+		mTris[best*3 + 1] = a;
+		mTris[best*3 + 2] = p;
+		mTris.push_back(c);
+		mTris.push_back(p);
+		mTris.push_back(b);
+		int second = numTris;
+		int third = -1;
+		if (other >= 0) {
+			int d = -1;
+			for (int j=0; j<3; j++) {
+				int o = mTris[other*3 + j];
+				if (o != a && o != b) {
+					d = o;
+				}
+			}
+			mTris[other*3] = d;
+			mTris[other*3 + 1] = b;
+			mTris[other*3 + 2] = p;
+			mTris.push_back(d);
+			mTris.push_back(p);
+			mTris.push_back(a);
+			third = numTris + 1;
+		}
+
+		legalize(best, 0);
+		legalize(second, 2);
+		if (other >= 0) {
+			legalize(other, 0);
+			legalize(third, 2);
+		}
+		return;
+	}
+
+	mTris[best*3 + 2] = p;
+	mTris.push_back(v[1]);
+	mTris.push_back(v[2]);
+	mTris.push_back(p);
+	mTris.push_back(v[2]);
+	mTris.push_back(v[0]);
+	mTris.push_back(p);
+	legalize(best, 0);
+	legalize(numTris, 0);
+	legalize(numTris + 1, 0);
+}
+
+int PlanarTriangulation::findTriangle(int a, int b) const
+{
+	// The triangle holding the directed edge a -> b.
+	int numTris = mTris.size() / 3;
+	for (int t=0; t<numTris; t++) {
+		for (int k=0; k<3; k++) {
+			if (mTris[t*3 + k] == a && mTris[t*3 + (k+1)%3] == b) {
+				return t;
+			}
+		}
+	}
+	return -1;
+}
+
+bool PlanarTriangulation::hasEdge(int a, int b) const
+{
+	return findTriangle(a, b) >= 0 || findTriangle(b, a) >= 0;
+}
+
+bool PlanarTriangulation::flip(int tri, int edge)
+{
+	// Flips edge (edge, edge+1) of tri if the quad around it is convex.
+	int a = mTris[tri*3 + edge];
+	int b = mTris[tri*3 + (edge+1)%3];
+	int c = mTris[tri*3 + (edge+2)%3];
+	int other = findTriangle(b, a);
+	if (other < 0) {
+		return false;
+	}
+	int d = -1;
+	for (int j=0; j<3; j++) {
+		int o = mTris[other*3 + j];
+		if (o != a && o != b) {
+			d = o;
+		}
+	}
+	if (orient2d(&mXY[c*2], &mXY[a*2], &mXY[d*2]) <= 0.0 ||
+		orient2d(&mXY[d*2], &mXY[b*2], &mXY[c*2]) <= 0.0) {
+		return false;
+	}
+	mTris[tri*3] = c;
+	mTris[tri*3 + 1] = a;
+	mTris[tri*3 + 2] = d;
+	mTris[other*3] = d;
+	mTris[other*3 + 1] = b;
+	mTris[other*3 + 2] = c;
+	return true;
+}
+
+void PlanarTriangulation::legalize(int tri, int edge)
+{
+	// Lawson flips towards a Delaunay triangulation, which keeps the pieces
+	// well shaped for the point location of later insertions.
+	int a = mTris[tri*3 + edge];
+	int b = mTris[tri*3 + (edge+1)%3];
+	int c = mTris[tri*3 + (edge+2)%3];
+	int other = findTriangle(b, a);
+	if (other < 0) {
+		return;
+	}
+	int d = -1;
+	for (int j=0; j<3; j++) {
+		int o = mTris[other*3 + j];
+		if (o != a && o != b) {
+			d = o;
+		}
+	}
+
+	const double *pa = &mXY[a*2];
+	const double *pb = &mXY[b*2];
+	const double *pc = &mXY[c*2];
+	const double *pd = &mXY[d*2];
+	double adx = pa[0] - pd[0], ady = pa[1] - pd[1];
+	double bdx = pb[0] - pd[0], bdy = pb[1] - pd[1];
+	double cdx = pc[0] - pd[0], cdy = pc[1] - pd[1];
+	double incircle = (adx*adx + ady*ady) * (bdx*cdy - cdx*bdy) +
+		(bdx*bdx + bdy*bdy) * (cdx*ady - adx*cdy) +
+		(cdx*cdx + cdy*cdy) * (adx*bdy - bdx*ady);
+	if (incircle <= mEpsilon * mEpsilon) {
+		return;
+	}
+	if (flip(tri, edge)) {
+		// tri is now (c, a, d) and other (d, b, c).
+		legalize(tri, 1);
+		legalize(other, 0);
+	}
+}
+
+bool PlanarTriangulation::crosses(int a, int b, int u, int w) const
+{
+	const double *pa = &mXY[a*2];
+	const double *pb = &mXY[b*2];
+	const double *pu = &mXY[u*2];
+	const double *pw = &mXY[w*2];
+	double d1 = orient2d(pa, pb, pu);
+	double d2 = orient2d(pa, pb, pw);
+	double d3 = orient2d(pu, pw, pa);
+	double d4 = orient2d(pu, pw, pb);
+	return ((d1 > 0.0 && d2 < 0.0) || (d1 < 0.0 && d2 > 0.0)) &&
+		((d3 > 0.0 && d4 < 0.0) || (d3 < 0.0 && d4 > 0.0));
+}
+
+bool PlanarTriangulation::insertConstraint(int idA, int idB,
+										   std::unordered_set<unsigned long long> &curveEdges)
+{
+	int a = findLocal(idA);
+	int b = findLocal(idB);
+	if (a < 0 || b < 0 || a == b) {
+		return true;
+	}
+
+	// A vertex lying on the segment splits it in two.
+	double length2 = 0.0;
+	for (int k=0; k<2; k++) {
+		double d = mXY[b*2 + k] - mXY[a*2 + k];
+		length2 += d * d;
+	}
+	for (int i=0; i<(int)mIds.size(); i++) {
+		if (mAlias[i] != i || i == a || i == b) {
+			continue;
+		}
+		double area = orient2d(&mXY[a*2], &mXY[b*2], &mXY[i*2]);
+		if (area * area > 1e-18 * length2 * length2) {
+			continue;
+		}
+		double t = 0.0;
+		for (int k=0; k<2; k++) {
+			t += (mXY[i*2 + k] - mXY[a*2 + k]) * (mXY[b*2 + k] - mXY[a*2 + k]);
+		}
+		if (t > 0.0 && t < length2) {
+			bool first = insertConstraint(idA, mIds[i], curveEdges);
+			return insertConstraint(mIds[i], idB, curveEdges) && first;
+		}
+	}
+
+	// Flip away the edges crossing the segment (Sloan).
+	std::vector<unsigned long long> crossing;
+	int numTris = mTris.size() / 3;
+	for (int t=0; t<numTris; t++) {
+		for (int k=0; k<3; k++) {
+			int u = mTris[t*3 + k];
+			int w = mTris[t*3 + (k+1)%3];
+			if (u < w && crosses(a, b, u, w)) {
+				crossing.push_back(key(u, w));
+			}
+		}
+	}
+
+	int budget = 64 + (int)(crossing.size() * crossing.size()) * 4;
+	while (!crossing.empty() && budget-- > 0) {
+		unsigned long long e = crossing.front();
+		crossing.erase(crossing.begin());
+		int u = (int)(e >> 32);
+		int w = (int)(e & 0xffffffffu);
+		int tri = findTriangle(u, w);
+		if (tri < 0) {
+			continue;
+		}
+		int edge = 0;
+		while (mTris[tri*3 + edge] != u) {
+			edge++;
+		}
+		if (!flip(tri, edge)) {
+			crossing.push_back(e);
+			continue;
+		}
+		// The new diagonal is (c, d) in the notation of flip().
+		int c = mTris[tri*3];
+		int d = mTris[tri*3 + 2];
+		if (crosses(a, b, c, d)) {
+			crossing.push_back(key(c, d));
+		}
+	}
+
+	// Out of flips: without the edge the curve has a gap, the patches on
+	// either side of it merge and get one class between them.
+	if (!hasEdge(a, b)) {
+		return false;
+	}
+	curveEdges.insert(key(mIds[a], mIds[b]));
+	return true;
+}
+
+void PlanarTriangulation::getTriangles(std::vector<int> &triangles) const
+{
+	for (int i=0; i<(int)mTris.size(); i++) {
+		triangles.push_back(mIds[mTris[i]]);
+	}
+}
+
+}
+
+void TBNativeOperand::load(const TBMesh &mesh)
+{
+	const std::vector<Vector3f> &local = mesh.getLocalVertices();
+	const TBAffine &xform = mesh.getTransform();
+	int numVertices = local.size();
+
+	vertices.resize(numVertices);
+	for (int i=0; i<numVertices; i++) {
+		Vector3f v = xform * local[i];
+		vertices[i] = Vector3d(v.X(), v.Y(), v.Z());
+	}
+	indices = mesh.getIndices();
+
+	// Orient the operand outwards, whatever order the generator used.
+	int numTriangles = indices.size() / 3;
+	double volume = 0.0;
+	for (int t=0; t<numTriangles; t++) {
+		const int *v = &indices[t*3];
+		volume += vertices[v[0]].Dot(vertices[v[1]].Cross(vertices[v[2]]));
+	}
+	if (volume < 0.0) {
+		for (int t=0; t<numTriangles; t++) {
+			std::swap(indices[t*3 + 1], indices[t*3 + 2]);
+		}
+	}
+	resetBvh();
+}
+
+void TBNativeOperand::append(const TBNativeOperand &other)
+{
+	int offset = vertices.size();
+	vertices.insert(vertices.end(), other.vertices.begin(), other.vertices.end());
+	indices.reserve(indices.size() + other.indices.size());
+	for (int i=0; i<(int)other.indices.size(); i++) {
+		indices.push_back(other.indices[i] + offset);
+	}
+	resetBvh();
+}
+
+TBBox TBNativeOperand::getBounds() const
+{
+	if (!mBvh.isEmpty()) {
+		return mBvh.getBounds();
+	}
+	TBBox box;
+	for (int i=0; i<(int)vertices.size(); i++) {
+		double point[3] = { vertices[i].X(), vertices[i].Y(), vertices[i].Z() };
+		box.include(point);
+	}
+	return box;
+}
+
+bool TBNativeOperand::isSelfIntersecting() const
+{
+	std::vector<int> pairs;
+	getBvh().queryPairs(getBvh(), pairs);
+
+	for (int i=0; i<(int)pairs.size(); i+=2) {
+		const int *t[2] = { &indices[pairs[i] * 3], &indices[pairs[i + 1] * 3] };
+		int shared = 0;
+		for (int j=0; j<3; j++) {
+			for (int k=0; k<3; k++) {
+				shared += t[0][j] == t[1][k] ? 1 : 0;
+			}
+		}
+		if (shared >= 2) {
+			continue;
+		}
+
+		// Any crossing shows up as an edge of one triangle passing through
+		// the other. Edges through a shared vertex cannot cross strictly.
+		for (int side=0; side<2; side++) {
+			const int *e = t[side];
+			const int *f = t[1 - side];
+			const Vector3d &a = vertices[f[0]];
+			const Vector3d &b = vertices[f[1]];
+			const Vector3d &c = vertices[f[2]];
+			for (int k=0; k<3; k++) {
+				int u = e[k];
+				int v = e[(k+1)%3];
+				if (shared > 0 && (u == f[0] || u == f[1] || u == f[2] ||
+								   v == f[0] || v == f[1] || v == f[2])) {
+					continue;
+				}
+				if (segmentCrossesTriangle(vertices[u], vertices[v], a, b, c)) {
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+void TBNativeOperand::resetBvh()
+{
+	mBvh.clear();
+}
+
+const TBBvh &TBNativeOperand::getBvh() const
+{
+	if (!mBvh.isEmpty() || indices.empty()) {
+		return mBvh;
+	}
+
+	int numTriangles = indices.size() / 3;
+	std::vector<TBBox> boxes(numTriangles);
+	for (int t=0; t<numTriangles; t++) {
+		for (int k=0; k<3; k++) {
+			const Vector3d &p = vertices[indices[t*3 + k]];
+			double point[3] = { p.X(), p.Y(), p.Z() };
+			boxes[t].include(point);
+		}
+	}
+	mBvh.build(boxes);
+	return mBvh;
+}
+
+void TBNativeOperand::toMesh(TBMesh &mesh) const
+{
+	if (indices.empty()) {
+		return;
+	}
+	std::vector<Vector3f> points(vertices.size());
+	for (int i=0; i<(int)vertices.size(); i++) {
+		const Vector3d &p = vertices[i];
+		points[i] = Vector3f((float)p.X(), (float)p.Y(), (float)p.Z());
+	}
+	mesh.appendIndexed(&points[0], points.size(), &indices[0], indices.size());
+}
+
+TBNativeBoolean::TBNativeBoolean(const TBMesh &a, const TBMesh &b)
+{
+	mLoaded[0].load(a);
+	mLoaded[1].load(b);
+	mOperands[0] = &mLoaded[0];
+	mOperands[1] = &mLoaded[1];
+	compute();
+}
+
+TBNativeBoolean::TBNativeBoolean(const TBNativeOperand &a, const TBNativeOperand &b)
+{
+	mOperands[0] = &a;
+	mOperands[1] = &b;
+	compute();
+}
+
+TBNativeBoolean::~TBNativeBoolean()
+{
+
+}
+
+void TBNativeBoolean::compute()
+{
+	mResolved = true;
+	mOffsets[0] = 0;
+	mOffsets[1] = mOperands[0]->vertices.size();
+
+	mPoints.reserve(mOperands[0]->vertices.size() + mOperands[1]->vertices.size());
+	for (int side=0; side<2; side++) {
+		mPoints.insert(mPoints.end(), mOperands[side]->vertices.begin(),
+					   mOperands[side]->vertices.end());
+	}
+
+	intersect();
+	for (int side=0; side<2; side++) {
+		split(side);
+	}
+	for (int side=0; side<2; side++) {
+		classify(side);
+	}
+}
+
+unsigned long long TBNativeBoolean::edgeKey(int u, int v)
+{
+	if (u > v) {
+		std::swap(u, v);
+	}
+	return ((unsigned long long)(unsigned int)u << 32) | (unsigned int)v;
+}
+
+int TBNativeBoolean::crossing(int side, int u, int v, int triangle)
+{
+	// Crossing of edge (u, v) of operand side with a triangle of the other
+	// operand. Results are cached so every triangle around the edge gets the
+	// same point id.
+	if (u > v) {
+		std::swap(u, v);
+	}
+	std::vector<int> &cached = mCrossings[side][edgeKey(u, v)];
+	for (int i=0; i<(int)cached.size(); i+=2) {
+		if (cached[i] == triangle) {
+			return cached[i + 1];
+		}
+	}
+
+	const TBNativeOperand &edgeOwner = *mOperands[side];
+	const TBNativeOperand &other = *mOperands[1 - side];
+	const Vector3d &p = edgeOwner.vertices[u];
+	const Vector3d &q = edgeOwner.vertices[v];
+	const int *t = &other.indices[triangle * 3];
+
+	int result = -1;
+	double dp = orient3d(other.vertices[t[0]], other.vertices[t[1]], other.vertices[t[2]], p);
+	double dq = orient3d(other.vertices[t[0]], other.vertices[t[1]], other.vertices[t[2]], q);
+	if (sign(dp) != sign(dq)) {
+		// The segment crosses the plane; check it passes inside all three
+		// edges. Each edge is evaluated in a canonical direction so the two
+		// triangles sharing it agree on which one the segment goes through.
+		int side0 = 0;
+		bool inside = true;
+		for (int k=0; k<3 && inside; k++) {
+			int a = t[k];
+			int b = t[(k+1)%3];
+			int s = a < b ? sign(orient3d(p, q, other.vertices[a], other.vertices[b]))
+						  : -sign(orient3d(p, q, other.vertices[b], other.vertices[a]));
+			if (k == 0) {
+				side0 = s;
+			} else if (s != side0) {
+				inside = false;
+			}
+		}
+
+		if (inside) {
+			if (dp == 0.0) {
+				result = mOffsets[side] + u;
+			} else if (dq == 0.0) {
+				result = mOffsets[side] + v;
+			} else {
+				double s = dp / (dp - dq);
+				result = mPoints.size();
+				mPoints.push_back(p + (q - p) * s);
+			}
+		}
+	}
+
+	cached.push_back(triangle);
+	cached.push_back(result);
+	return result;
+}
+
+void TBNativeBoolean::intersect()
+{
+	std::vector<int> pairs;
+	mOperands[0]->getBvh().queryPairs(mOperands[1]->getBvh(), pairs);
+
+	for (int side=0; side<2; side++) {
+		mSegments[side].resize(mOperands[side]->indices.size() / 3);
+	}
+
+	for (int i=0; i<(int)pairs.size(); i+=2) {
+		int tri[2] = { pairs[i], pairs[i + 1] };
+
+		int ids[6];
+		int numIds = 0;
+		for (int side=0; side<2; side++) {
+			const int *t = &mOperands[side]->indices[tri[side] * 3];
+			for (int k=0; k<3; k++) {
+				int id = crossing(side, t[k], t[(k+1)%3], tri[1 - side]);
+				if (id < 0) {
+					continue;
+				}
+				bool known = false;
+				for (int j=0; j<numIds; j++) {
+					known = known || ids[j] == id;
+				}
+				if (!known) {
+					ids[numIds++] = id;
+				}
+			}
+		}
+		if (numIds < 2) {
+			continue;
+		}
+
+		// Two triangles meet in one segment. More points only show up in
+		// degenerate configurations; keep the two farthest apart.
+		int first = 0, second = 1;
+		if (numIds > 2) {
+			double best = -1.0;
+			for (int j=0; j<numIds; j++) {
+				for (int k=j+1; k<numIds; k++) {
+					double d = (mPoints[ids[j]] - mPoints[ids[k]]).SquaredLength();
+					if (d > best) {
+						best = d;
+						first = j;
+						second = k;
+					}
+				}
+			}
+		}
+
+		for (int side=0; side<2; side++) {
+			mSegments[side][tri[side]].push_back(ids[first]);
+			mSegments[side][tri[side]].push_back(ids[second]);
+		}
+	}
+}
+
+void TBNativeBoolean::split(int side)
+{
+	const TBNativeOperand &operand = *mOperands[side];
+	int offset = mOffsets[side];
+	int numInput = mOffsets[1] + mOperands[1]->vertices.size();
+	int numTriangles = operand.indices.size() / 3;
+	std::vector<int> &output = mTriangles[side];
+	output.reserve(operand.indices.size());
+
+	std::vector<int> edgePoints;
+	for (int t=0; t<numTriangles; t++) {
+		const int *v = &operand.indices[t*3];
+		const std::vector<int> &segments = mSegments[side][t];
+
+		// Points on the edges of the triangle, including the ones produced
+		// for the neighbour across the edge, so the pieces stay conforming.
+		edgePoints.clear();
+		for (int k=0; k<3; k++) {
+			std::unordered_map<unsigned long long, std::vector<int> >::const_iterator it =
+				mCrossings[side].find(edgeKey(v[k], v[(k+1)%3]));
+			if (it == mCrossings[side].end()) {
+				continue;
+			}
+			for (int i=1; i<(int)it->second.size(); i+=2) {
+				if (it->second[i] >= numInput) {
+					edgePoints.push_back(it->second[i]);
+				}
+			}
+		}
+
+		if (segments.empty() && edgePoints.empty()) {
+			for (int k=0; k<3; k++) {
+				output.push_back(offset + v[k]);
+			}
+			continue;
+		}
+
+		PlanarTriangulation triangulation(mPoints, offset + v[0],
+										  offset + v[1], offset + v[2]);
+		for (int i=0; i<(int)edgePoints.size(); i++) {
+			triangulation.insertPoint(edgePoints[i]);
+		}
+		for (int i=0; i<(int)segments.size(); i++) {
+			triangulation.insertPoint(segments[i]);
+		}
+		for (int i=0; i<(int)segments.size(); i+=2) {
+			if (!triangulation.insertConstraint(segments[i], segments[i + 1], mCurveEdges)) {
+				mResolved = false;
+			}
+		}
+		triangulation.getTriangles(output);
+	}
+}
+
+bool TBNativeBoolean::isInside(const Vector3d &point, const TBNativeOperand &operand) const
+{
+	// Ray parity. Rays grazing an edge or a vertex are ambiguous, so they
+	// are retried in another direction.
+	static const double directions[][3] = {
+		{ 0.5773502692, 0.5773502692, 0.5773502692 },
+		{ -0.3841106397, 0.7682212795, 0.5121475197 },
+		{ 0.8017837257, -0.2672612419, 0.5345224838 },
+		{ -0.6246950476, -0.6246950476, 0.4685212857 },
+		{ 0.1825741858, 0.3651483717, -0.9128709292 }
+	};
+	const int numDirections = sizeof(directions) / sizeof(directions[0]);
+
+	double origin[3] = { point.X(), point.Y(), point.Z() };
+	std::vector<int> candidates;
+	int crossings = 0;
+	for (int d=0; d<numDirections; d++) {
+		Vector3d dir(directions[d][0], directions[d][1], directions[d][2]);
+		candidates.clear();
+		operand.getBvh().queryRay(origin, directions[d], candidates);
+
+		bool ambiguous = false;
+		crossings = 0;
+		for (int i=0; i<(int)candidates.size() && !ambiguous; i++) {
+			const int *t = &operand.indices[candidates[i] * 3];
+			const Vector3d &p0 = operand.vertices[t[0]];
+			Vector3d e1 = operand.vertices[t[1]] - p0;
+			Vector3d e2 = operand.vertices[t[2]] - p0;
+			Vector3d h = dir.Cross(e2);
+			double det = e1.Dot(h);
+			double scale = e1.Length() * e2.Length();
+			if (std::fabs(det) <= 1e-12 * scale) {
+				// Parallel to the plane: only a problem if the ray lies in it.
+				Vector3d n = e1.Cross(e2);
+				if (std::fabs(n.Dot(point - p0)) <= 1e-12 * scale) {
+					ambiguous = true;
+				}
+				continue;
+			}
+			Vector3d s = point - p0;
+			double u = s.Dot(h) / det;
+			Vector3d qv = s.Cross(e1);
+			double v = dir.Dot(qv) / det;
+			double dist = e2.Dot(qv) / det;
+			const double margin = 1e-9;
+			if (u < -margin || v < -margin || u + v > 1.0 + margin || dist < -margin) {
+				continue;
+			}
+			if (u < margin || v < margin || u + v > 1.0 - margin || dist < margin) {
+				ambiguous = true;
+				continue;
+			}
+			crossings++;
+		}
+		if (!ambiguous) {
+			break;
+		}
+	}
+	return (crossings & 1) != 0;
+}
+
+void TBNativeBoolean::classify(int side)
+{
+	const std::vector<int> &triangles = mTriangles[side];
+	int numTriangles = triangles.size() / 3;
+
+	// Union-find over pieces sharing an edge that is not on an intersection
+	// curve. Each resulting patch lies entirely inside or outside the other
+	// operand.
+	std::vector<int> parent(numTriangles);
+	for (int t=0; t<numTriangles; t++) {
+		parent[t] = t;
+	}
+	std::unordered_map<unsigned long long, int> firstOwner;
+	firstOwner.reserve(numTriangles * 2);
+	for (int t=0; t<numTriangles; t++) {
+		for (int k=0; k<3; k++) {
+			unsigned long long e = edgeKey(triangles[t*3 + k], triangles[t*3 + (k+1)%3]);
+			if (mCurveEdges.count(e) > 0) {
+				continue;
+			}
+			std::pair<std::unordered_map<unsigned long long, int>::iterator, bool> inserted =
+				firstOwner.insert(std::make_pair(e, t));
+			if (inserted.second) {
+				continue;
+			}
+			int a = inserted.first->second;
+			int b = t;
+			while (parent[a] != a) a = parent[a] = parent[parent[a]];
+			while (parent[b] != b) b = parent[b] = parent[parent[b]];
+			if (a != b) {
+				parent[std::max(a, b)] = std::min(a, b);
+			}
+		}
+	}
+
+	// Vote with the three largest pieces of each patch; slivers next to the
+	// curve have centroids too close to the other surface to trust.
+	std::vector<int> root(numTriangles);
+	std::vector<double> area(numTriangles);
+	std::vector<int> samples(numTriangles * 3, -1);
+	for (int t=0; t<numTriangles; t++) {
+		int r = t;
+		while (parent[r] != r) r = parent[r];
+		root[t] = r;
+		const int *v = &triangles[t*3];
+		area[t] = (mPoints[v[1]] - mPoints[v[0]]).Cross(mPoints[v[2]] - mPoints[v[0]]).SquaredLength();
+
+		int *best = &samples[r*3];
+		int candidate = t;
+		for (int i=0; i<3 && candidate >= 0; i++) {
+			if (best[i] < 0 || area[candidate] > area[best[i]]) {
+				std::swap(best[i], candidate);
+			}
+		}
+	}
+
+	// Patches whose box misses the other operand are outside without a ray.
+	const TBBox &otherBounds = mOperands[1 - side]->getBvh().getBounds();
+	std::vector<unsigned char> inside(numTriangles, 0);
+	for (int r=0; r<numTriangles; r++) {
+		if (root[r] != r) {
+			continue;
+		}
+		// A tie, one vote each way when the patch has two pieces, goes to
+		// the largest piece, the one the vote trusts most.
+		int votes = 0;
+		int largest = 0;
+		for (int i=0; i<3 && samples[r*3 + i] >= 0; i++) {
+			const int *v = &triangles[samples[r*3 + i] * 3];
+			Vector3d centroid = (mPoints[v[0]] + mPoints[v[1]] + mPoints[v[2]]) / 3.0;
+			double point[3] = { centroid.X(), centroid.Y(), centroid.Z() };
+			TBBox box;
+			box.include(point);
+			int vote = box.overlaps(otherBounds) && isInside(centroid, *mOperands[1 - side]) ? 1 : -1;
+			if (i == 0) {
+				largest = vote;
+			}
+			votes += vote;
+		}
+		inside[r] = votes > 0 || (votes == 0 && largest > 0) ? 1 : 0;
+	}
+
+	mInside[side].resize(numTriangles);
+	for (int t=0; t<numTriangles; t++) {
+		mInside[side][t] = inside[root[t]];
+	}
+}
+
+void TBNativeBoolean::gather(int parts, int flipped, std::vector<int> &pointIds,
+							 std::vector<int> &indices) const
+{
+	static const int outside[2] = { A_OUT_B, B_OUT_A };
+	static const int insideParts[2] = { A_IN_B, B_IN_A };
+
+	// Compacts the points used by the selected parts into pointIds.
+	std::vector<int> remap(mPoints.size(), -1);
+	for (int side=0; side<2; side++) {
+		const std::vector<int> &triangles = mTriangles[side];
+		int numTriangles = triangles.size() / 3;
+		for (int t=0; t<numTriangles; t++) {
+			int part = mInside[side][t] ? insideParts[side] : outside[side];
+			if ((parts & part) == 0) {
+				continue;
+			}
+			bool reverse = (flipped & part) != 0;
+			for (int k=0; k<3; k++) {
+				int id = triangles[t*3 + (reverse ? 2 - k : k)];
+				if (remap[id] < 0) {
+					remap[id] = pointIds.size();
+					pointIds.push_back(id);
+				}
+				indices.push_back(remap[id]);
+			}
+		}
+	}
+}
+
+void TBNativeBoolean::collect(int parts, int flipped, TBMesh &result) const
+{
+	std::vector<int> pointIds;
+	std::vector<int> indices;
+	gather(parts, flipped, pointIds, indices);
+	if (indices.empty()) {
+		return;
+	}
+
+	std::vector<Vector3f> vertices(pointIds.size());
+	for (int i=0; i<(int)pointIds.size(); i++) {
+		const Vector3d &p = mPoints[pointIds[i]];
+		vertices[i] = Vector3f((float)p.X(), (float)p.Y(), (float)p.Z());
+	}
+	result.appendIndexed(&vertices[0], vertices.size(), &indices[0], indices.size());
+}
+
+void TBNativeBoolean::collect(int parts, int flipped, TBNativeOperand &result) const
+{
+	std::vector<int> pointIds;
+	std::vector<int> indices;
+	gather(parts, flipped, pointIds, indices);
+
+	result.vertices.resize(pointIds.size());
+	for (int i=0; i<(int)pointIds.size(); i++) {
+		result.vertices[i] = mPoints[pointIds[i]];
+	}
+	result.indices.swap(indices);
+	result.resetBvh();
+}
+
+bool TBNativeBoolean::isResolved() const
+{
+	return mResolved;
+}
@@ -0,0 +1,117 @@
+#ifndef TBNATIVEBOOLEAN_H
+#define TBNATIVEBOOLEAN_H
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "tbmesh.h"
+#include "tbbvh.h"
+
+// Operand of TBNativeBoolean: world space vertices in double precision,
+// outward oriented triangles and their BVH. Results can be collected into
+// an operand directly, so chained booleans skip the conversion from TBMesh.
+struct TBNativeOperand
+{
+	std::vector<Vector3d> vertices;
+	std::vector<int> indices;
+
+	// Bakes the mesh transform and flips the triangles if they face inwards.
+	void load(const TBMesh &mesh);
+	void toMesh(TBMesh &mesh) const;
+	// Appends the triangles of other unchanged; only valid as a union when
+	// the two operands do not intersect.
+	void append(const TBNativeOperand &other);
+	TBBox getBounds() const;
+	// True if two triangles cross each other. Triangles sharing an edge are
+	// skipped and touching contacts are not reported; coplanar overlaps are
+	// not detected.
+	bool isSelfIntersecting() const;
+	// Built on first use; callers changing the triangles must reset it.
+	const TBBvh &getBvh() const;
+	void resetBvh();
+
+private:
+	mutable TBBvh mBvh;
+};
+
+// Mesh boolean that works directly on TBMesh index buffers.
+//
+// Both operands must be closed and free of self intersections. The
+// constructor does all the work in one pass:
+//   1. triangle pairs are culled with a BVH per operand,
+//   2. every edge of one operand is intersected with the triangles of the
+//      other; each crossing point is computed once and shared by every
+//      triangle that touches it,
+//   3. crossed triangles are retriangulated in their plane with the
+//      intersection segments as constrained edges,
+//   4. the pieces are grouped into patches bounded by intersection curves
+//      and each patch is classified inside or outside the other operand
+//      with a ray parity test against its BVH.
+// collect() then assembles any combination of the four classified parts.
+//
+// The predicates run in double precision with a consistent tie breaking
+// rule, which handles points lying exactly on a plane or an edge, but
+// coplanar overlapping faces are not supported. TBBoolean keeps the GTS
+// engine as a reference for validating results, and falls back to it when
+// this engine reports an unresolved intersection.
+class TBNativeBoolean
+{
+	public:
+		enum Part
+		{
+			A_OUT_B = 1,
+			A_IN_B = 2,
+			B_OUT_A = 4,
+			B_IN_A = 8
+		};
+
+		TBNativeBoolean(const TBMesh &a, const TBMesh &b);
+		// The operands are referenced, not copied, and must outlive this.
+		TBNativeBoolean(const TBNativeOperand &a, const TBNativeOperand &b);
+		~TBNativeBoolean();
+
+		// Appends the parts selected by the Part mask to result. Parts also
+		// set in flipped are written with reversed orientation.
+		void collect(int parts, int flipped, TBMesh &result) const;
+		// Replaces result with the selected parts.
+		void collect(int parts, int flipped, TBNativeOperand &result) const;
+		// False if an intersection segment could not be inserted into a
+		// triangle. The classes are then unreliable and TBBoolean redoes the
+		// operation with GTS instead of collecting them.
+		bool isResolved() const;
+
+	private:
+		void compute();
+		void gather(int parts, int flipped, std::vector<int> &pointIds,
+					std::vector<int> &indices) const;
+		void intersect();
+		int crossing(int side, int u, int v, int triangle);
+		void split(int side);
+		void classify(int side);
+		bool isInside(const Vector3d &point, const TBNativeOperand &operand) const;
+		static unsigned long long edgeKey(int u, int v);
+
+	private:
+		TBNativeOperand mLoaded[2];
+		const TBNativeOperand *mOperands[2];
+		int mOffsets[2];
+
+		// Operand vertices first, then the intersection points.
+		std::vector<Vector3d> mPoints;
+
+		// Per operand: intersection segments of each input triangle, as
+		// pairs of point ids, and the output triangles and their classes.
+		std::vector<std::vector<int> > mSegments[2];
+		std::vector<int> mTriangles[2];
+		std::vector<unsigned char> mInside[2];
+
+		// Per operand: crossings of each edge with triangles of the other
+		// operand, as (triangle, point id) pairs with -1 for a miss.
+		std::unordered_map<unsigned long long, std::vector<int> > mCrossings[2];
+
+		// Sub-edges of the intersection curves in the output triangles.
+		std::unordered_set<unsigned long long> mCurveEdges;
+		bool mResolved;
+};
+
+#endif
@@ -0,0 +1,403 @@
+#include "tbrotor.h"
+#include "Wm5ConvexHull3.h"
+#include "tridprofile.h"
+#include "tbthreadpool.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+Circle3f makeCircle(float x, float y, float radius)
+{
+	return Circle3f(Vector3f(x, y, 0.0f), Vector3f::UNIT_X, Vector3f::UNIT_Y, Vector3f::UNIT_Z, radius);
+}
+
+Circle3f interpolateCircle(const Circle3f &begin, const Circle3f &end, int count, int index)
+{
+	float t = index * (1.0f / count);
+	Vector3f center = begin.Center + (end.Center - begin.Center) * t;
+	float radius = begin.Radius + (end.Radius - begin.Radius) * t;
+	return Circle3f(center, begin.Direction0, begin.Direction1, begin.Normal, radius);
+}
+
+// Samples the profile at the given height, counts[k] samples on piece k, or
+// numSamples spread evenly when counts is null.
+void createSamples(const TridProfile &profile, const std::vector<int> *counts, int numSamples,
+				   std::vector<Vector3f> &vertices, float height)
+{
+	size_t first = vertices.size();
+	if (counts) {
+		profile.GetSamples(*counts, vertices);
+	} else {
+		profile.GetSamples(numSamples, vertices);
+	}
+	for (size_t i=first; i<vertices.size(); i++) {
+		// TridProfile always computes the outline on the xy plane.
+		vertices[i].Z() = height;
+	}
+}
+
+// Reads exactly count numbers and nothing else from the rest of the line.
+bool readValues(std::istringstream &line, float *values, int count)
+{
+	for (int i=0; i<count; i++) {
+		if (!(line >> values[i])) {
+			return false;
+		}
+	}
+	std::string extra;
+	return !(line >> extra);
+}
+
+}
+
+TBRotorParams::TBRotorParams()
+	: numSteps(10), height(10.0f), chordTolerance(0.01f),
+	  numWings(3), wingPitch(25.0f * Mathf::DEG_TO_RAD), wingOffset(-0.5f, 0.0f, 2.5f),
+	  bodyRadius(4.0f), bodyHalfHeight(2.0f)
+{
+	beginCircles.push_back(makeCircle(-2.0f, 0.0f, 0.5f));
+	beginCircles.push_back(makeCircle(0.0f, 0.0f, 1.0f));
+	beginCircles.push_back(makeCircle(3.0f, 0.0f, 0.5f));
+	endCircles.push_back(makeCircle(-1.0f, 0.0f, 0.1f));
+	endCircles.push_back(makeCircle(0.0f, 0.0f, 0.2f));
+	endCircles.push_back(makeCircle(1.0f, 0.0f, 0.1f));
+}
+
+bool TBRotorParams::load(const char *path, std::string *error)
+{
+	std::ifstream file(path);
+	if (!file) {
+		if (error) {
+			*error = std::string(path) + ": cannot open the file";
+		}
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	return parse(text.str(), path, error);
+}
+
+bool TBRotorParams::parse(const std::string &text, const char *source, std::string *error)
+{
+	TBRotorParams params = *this;
+	bool hasBegin = false, hasEnd = false;
+
+	std::istringstream lines(text);
+	std::string line;
+	for (int lineNumber=1; std::getline(lines, line); lineNumber++) {
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.erase(comment);
+		}
+		std::istringstream fields(line);
+		std::string key;
+		if (!(fields >> key)) {
+			continue;
+		}
+
+		float v[3];
+		bool valid;
+		if (key == "begin_circle" || key == "end_circle") {
+			valid = readValues(fields, v, 3);
+			if (valid) {
+				bool isBegin = key == "begin_circle";
+				std::vector<Circle3f> &circles = isBegin ? params.beginCircles : params.endCircles;
+				bool &hasCircles = isBegin ? hasBegin : hasEnd;
+				if (!hasCircles) {
+					circles.clear();
+					hasCircles = true;
+				}
+				circles.push_back(makeCircle(v[0], v[1], v[2]));
+			}
+		} else if (key == "steps" || key == "wings") {
+			valid = readValues(fields, v, 1) && v[0] == (int)v[0];
+			if (valid) {
+				(key == "steps" ? params.numSteps : params.numWings) = (int)v[0];
+			}
+		} else if (key == "height") {
+			valid = readValues(fields, &params.height, 1);
+		} else if (key == "chord_tolerance") {
+			valid = readValues(fields, &params.chordTolerance, 1);
+		} else if (key == "wing_pitch") {
+			valid = readValues(fields, v, 1);
+			if (valid) {
+				params.wingPitch = v[0] * Mathf::DEG_TO_RAD;
+			}
+		} else if (key == "wing_offset") {
+			valid = readValues(fields, v, 3);
+			if (valid) {
+				params.wingOffset = Vector3f(v[0], v[1], v[2]);
+			}
+		} else if (key == "body_radius") {
+			valid = readValues(fields, &params.bodyRadius, 1);
+		} else if (key == "body_half_height") {
+			valid = readValues(fields, &params.bodyHalfHeight, 1);
+		} else {
+			if (error) {
+				std::ostringstream message;
+				message << source << ":" << lineNumber << ": unknown key '" << key << "'";
+				*error = message.str();
+			}
+			return false;
+		}
+
+		if (!valid) {
+			if (error) {
+				std::ostringstream message;
+				message << source << ":" << lineNumber << ": bad value for '" << key << "'";
+				*error = message.str();
+			}
+			return false;
+		}
+	}
+
+	std::string problem = params.check();
+	if (!problem.empty()) {
+		if (error) {
+			*error = std::string(source) + ": " + problem;
+		}
+		return false;
+	}
+	*this = params;
+	return true;
+}
+
+std::string TBRotorParams::toText() const
+{
+	std::ostringstream text;
+	text << std::setprecision(9);
+	for (size_t i=0; i<beginCircles.size(); i++) {
+		const Circle3f &circle = beginCircles[i];
+		text << "begin_circle " << circle.Center.X() << " " << circle.Center.Y() << " " << circle.Radius << "\n";
+	}
+	for (size_t i=0; i<endCircles.size(); i++) {
+		const Circle3f &circle = endCircles[i];
+		text << "end_circle " << circle.Center.X() << " " << circle.Center.Y() << " " << circle.Radius << "\n";
+	}
+	text << "steps " << numSteps << "\n";
+	text << "height " << height << "\n";
+	text << "chord_tolerance " << chordTolerance << "\n";
+	text << "wings " << numWings << "\n";
+	text << "wing_pitch " << wingPitch * Mathf::RAD_TO_DEG << "\n";
+	text << "wing_offset " << wingOffset.X() << " " << wingOffset.Y() << " " << wingOffset.Z() << "\n";
+	text << "body_radius " << bodyRadius << "\n";
+	text << "body_half_height " << bodyHalfHeight << "\n";
+	return text.str();
+}
+
+std::string TBRotorParams::check() const
+{
+	if (beginCircles.empty()) {
+		return "a wing needs at least one circle";
+	}
+	if (beginCircles.size() != endCircles.size()) {
+		return "there must be as many end circles as begin circles";
+	}
+	for (size_t i=0; i<beginCircles.size(); i++) {
+		if (beginCircles[i].Radius <= 0.0f || endCircles[i].Radius <= 0.0f) {
+			return "circle radii must be positive";
+		}
+	}
+	if (numSteps < 1) {
+		return "steps must be at least 1";
+	}
+	if (numWings < 1) {
+		return "wings must be at least 1";
+	}
+	if (height <= 0.0f || chordTolerance <= 0.0f || bodyRadius <= 0.0f || bodyHalfHeight <= 0.0f) {
+		return "height, chord tolerance and body sizes must be positive";
+	}
+	return std::string();
+}
+
+TBRotor::TBRotor(const TBRotorParams &params)
+	: mParams(params)
+{
+	assertion(params.check().empty(), "Invalid rotor parameters: %s\n", params.check().c_str());
+}
+
+const TBRotorParams &TBRotor::getParams() const
+{
+	return mParams;
+}
+
+TBWingProfile::TBWingProfile()
+	: outline(NULL)
+{
+}
+
+TBWingProfile::~TBWingProfile()
+{
+	delete0(outline);
+}
+
+void TBRotor::createWing(TBMesh &mesh, float tolerance) const
+{
+	int numSections = mParams.numSteps + 1;
+	TBThreadPool &pool = TBThreadPool::getShared();
+
+	// Profiles only depend on the interpolated circles of their own step,
+	// so they are all created at once.
+	std::vector<TBWingProfile> profiles(numSections);
+	pool.parallelFor(numSections, [&](int step) {
+		createProfile(step, tolerance, profiles[step]);
+	});
+
+	std::vector<const TBWingProfile *> layoutProfiles(numSections);
+	for (int step=0; step<numSections; step++) {
+		layoutProfiles[step] = &profiles[step];
+	}
+	std::vector<int> counts;
+	int numSamples;
+	getSampleLayout(layoutProfiles, counts, numSamples);
+
+	std::vector<std::vector<Vector3f> > sections(numSections);
+	pool.parallelFor(numSections, [&](int step) {
+		createSection(profiles[step], step, counts, numSamples, sections[step]);
+		delete0(profiles[step].outline);
+		profiles[step].outline = NULL;
+	});
+
+	// Sections have matching sample counts and ordering, so each slab is a
+	// quad strip; the first and last sections are capped.
+	mesh.loft(&sections[0], numSections);
+}
+
+void TBRotor::getSectionCircles(int step, std::vector<Circle3f> &circles) const
+{
+	int numCircles = mParams.beginCircles.size();
+	circles.resize(numCircles);
+	for (int k=0; k<numCircles; k++) {
+		circles[k] = interpolateCircle(mParams.beginCircles[k], mParams.endCircles[k], mParams.numSteps, step);
+	}
+}
+
+void TBRotor::createProfile(int step, float tolerance, TBWingProfile &profile) const
+{
+	std::vector<Circle3f> circles;
+	getSectionCircles(step, circles);
+	delete0(profile.outline);
+	profile.outline = new0 TridProfile(&circles[0], circles.size());
+	profile.counts.clear();
+	profile.outline->GetSampleCounts(tolerance, profile.counts);
+}
+
+void TBRotor::getSampleLayout(const std::vector<const TBWingProfile *> &profiles,
+							  std::vector<int> &counts, int &numSamples)
+{
+	counts.clear();
+	bool sameLayout = true;
+	numSamples = 3;
+	for (int step=0; step<(int)profiles.size(); step++) {
+		const std::vector<int> &stepCounts = profiles[step]->counts;
+		int total = 0;
+		for (int k=0; k<(int)stepCounts.size(); k++) {
+			total += stepCounts[k];
+		}
+		numSamples = std::max(numSamples, total);
+
+		if (step == 0) {
+			counts = stepCounts;
+		} else if (sameLayout && profiles[step]->outline->HasSameLayout(*profiles[0]->outline)) {
+			for (int k=0; k<(int)counts.size(); k++) {
+				counts[k] = std::max(counts[k], stepCounts[k]);
+			}
+		} else {
+			sameLayout = false;
+		}
+	}
+	if (!sameLayout) {
+		counts.clear();
+	}
+}
+
+void TBRotor::createSection(const TBWingProfile &profile, int step, const std::vector<int> &counts,
+							int numSamples, std::vector<Vector3f> &vertices) const
+{
+	float height = step * (mParams.height / mParams.numSteps);
+	createSamples(*profile.outline, counts.empty() ? NULL : &counts, numSamples, vertices, height);
+}
+
+void TBRotor::createBody(TBMesh &mesh, float tolerance) const
+{
+	float halfHeight = mParams.bodyHalfHeight;
+	float radius = mParams.bodyRadius;
+	int sampleCount = TridProfile::GetSegmentCount(radius, Mathf::TWO_PI, tolerance);
+	sampleCount = std::max(sampleCount, 3);
+	int numVertices = sampleCount * 2 + 2;
+	Vector3f *vertices = new1<Vector3f>(numVertices);
+	float angle = Mathf::TWO_PI / sampleCount;
+	for (int i=0; i<sampleCount; i++) {
+		float x = radius * Mathf::Cos(angle * i);
+		float y = radius * Mathf::Sin(angle * i);
+		vertices[i] = Vector3f(x, y, -halfHeight);
+		vertices[i + sampleCount] = Vector3f(x, y, halfHeight);
+	}
+
+	vertices[sampleCount * 2] = Vector3f(0.0f, 0.0f, -halfHeight - 0.01f);
+	vertices[sampleCount * 2 + 1] = Vector3f(0.0f, 0.0f, halfHeight + 0.01f);
+
+	ConvexHull3f *hull = new0 ConvexHull3f(numVertices, vertices, 0.0001f, false, Query::QT_REAL);
+
+	int numTriangles = hull->GetNumSimplices();
+	mesh.appendIndexed(vertices, numVertices, hull->GetIndices(), numTriangles * 3);
+
+	delete1(vertices);
+	delete0(hull);
+}
+
+void TBRotor::placeWing(TBMesh &wing, int index) const
+{
+	Transform pitch;
+	pitch.SetRotate(HMatrix(AVector::UNIT_Z, mParams.wingPitch));
+	wing.queueTransform(pitch);
+	Transform offset;
+	offset.SetTranslate(mParams.wingOffset);
+	wing.queueTransform(offset);
+	if (index > 0) {
+		Transform turn;
+		turn.SetRotate(HMatrix(AVector::UNIT_Y, index * Mathf::TWO_PI / mParams.numWings));
+		wing.queueTransform(turn);
+	}
+}
+
+void TBRotor::placeBody(TBMesh &body) const
+{
+	Transform upright;
+	upright.SetRotate(HMatrix(AVector::UNIT_X, Mathf::HALF_PI));
+	body.transformBy(upright);
+}
+
+TBBoolean::Status TBRotor::createMesh(TBMesh &result, float tolerance) const
+{
+	// The wings share the storage of one wing; each one only carries its
+	// transform.
+	TBMesh wing;
+	createWing(wing, tolerance);
+	std::vector<TBMesh*> wings(mParams.numWings);
+	for (int i=0; i<mParams.numWings; i++) {
+		wings[i] = wing.clone();
+		placeWing(*wings[i], i);
+	}
+
+	TBMesh *body = new0 TBMesh();
+	createBody(*body, tolerance);
+	placeBody(*body);
+
+	// The wing unions are independent of each other until they meet the
+	// body, so they run in parallel.
+	std::vector<const TBMesh*> parts;
+	parts.push_back(body);
+	parts.insert(parts.end(), wings.begin(), wings.end());
+	TBBoolean::Status status = TBBoolean::unionAll(parts, result);
+
+	for (int i=0; i<mParams.numWings; i++) {
+		delete0(wings[i]);
+	}
+	delete0(body);
+
+	return status;
+}
@@ -0,0 +1,112 @@
+#ifndef TBROTOR_H
+#define TBROTOR_H
+
+#include <string>
+#include <vector>
+#include "Wm5Mathematics.h"
+#include "tbmesh.h"
+#include "tbmeshboolean.h"
+
+using namespace Wm5;
+
+class TridProfile;
+
+// Parameters of a rotor: a cylindrical body with wings evenly spaced around
+// it. Each wing is lofted along z from the outline of the begin circles to
+// the outline of the end circles, which are paired by index and given on
+// the xy plane.
+struct TBRotorParams
+{
+	std::vector<Circle3f> beginCircles;
+	std::vector<Circle3f> endCircles;
+	// Sections are taken at numSteps + 1 evenly spaced heights.
+	int numSteps;
+	float height;
+	// Largest distance allowed between a curved surface and its chords.
+	float chordTolerance;
+
+	int numWings;
+	// Rotation of the wing about its z axis, in radians, and its offset from
+	// the rotor axis before it is turned into place.
+	float wingPitch;
+	Vector3f wingOffset;
+
+	float bodyRadius;
+	float bodyHalfHeight;
+
+	// The default rotor, three wings on a body of radius 4.
+	TBRotorParams();
+
+	// Reads "key value..." lines; '#' starts a comment. Keys left out keep
+	// their current value, but giving any begin_circle or end_circle
+	// replaces that whole list. Angles are in degrees. On failure the
+	// parameters are left untouched and error, if given, tells why.
+	bool load(const char *path, std::string *error = NULL);
+	// Same as load(), from text in memory; source names it in the errors.
+	bool parse(const std::string &text, const char *source, std::string *error = NULL);
+	// The parameters in the format parse() reads.
+	std::string toText() const;
+
+	// Empty when the parameters can build a rotor.
+	std::string check() const;
+};
+
+// One wing section before it is sampled: the outline of its interpolated
+// circles and the samples each piece of it needs.
+struct TBWingProfile
+{
+	TBWingProfile();
+	~TBWingProfile();
+
+	TridProfile *outline;
+	std::vector<int> counts;
+
+private:
+	TBWingProfile(const TBWingProfile &);
+	TBWingProfile &operator=(const TBWingProfile &);
+};
+
+// Geometry pipeline of a rotor, from the parameters to the closed mesh. It
+// does not touch the renderer, so batch tools can run it headless.
+class TBRotor
+{
+public:
+	// Raised whenever the generator, or the boolean it uses, changes the
+	// mesh it makes from the same parameters, so saved meshes keyed on the
+	// parameters are not taken for new ones.
+	enum { GENERATOR_VERSION = 1 };
+
+	explicit TBRotor(const TBRotorParams &params);
+
+	const TBRotorParams &getParams() const;
+
+	// The wing before it is placed, sampled within tolerance.
+	void createWing(TBMesh &mesh, float tolerance) const;
+	// The steps of createWing(), for callers keeping sections between
+	// builds. Section step is interpolated between the begin and the end
+	// circles; its profile only depends on those circles and tolerance.
+	void getSectionCircles(int step, std::vector<Circle3f> &circles) const;
+	void createProfile(int step, float tolerance, TBWingProfile &profile) const;
+	// The lofted sections need the same sample layout, so each piece gets
+	// the most samples any section needs on it. If the pieces change along
+	// the wing, counts is left empty and every section is sampled evenly
+	// with numSamples, the largest total.
+	static void getSampleLayout(const std::vector<const TBWingProfile *> &profiles,
+								std::vector<int> &counts, int &numSamples);
+	void createSection(const TBWingProfile &profile, int step, const std::vector<int> &counts,
+					   int numSamples, std::vector<Vector3f> &vertices) const;
+	// The body cylinder along z, centred on the origin.
+	void createBody(TBMesh &mesh, float tolerance) const;
+	// Queue the transforms that take a wing, or the body, from where
+	// createWing() and createBody() make them to their place in the rotor.
+	void placeWing(TBMesh &wing, int index) const;
+	void placeBody(TBMesh &body) const;
+	// Union of the body, turned to the y axis, and the placed wings,
+	// appended to result.
+	TBBoolean::Status createMesh(TBMesh &result, float tolerance) const;
+
+private:
+	TBRotorParams mParams;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "tbrotormodel.h"
+#include "tbmeshfile.h"
+#include "tbthreadpool.h"
+#include <chrono>
+#include <string.h>
+
+namespace {
+
+template <class T>
+unsigned long long hashValue(const T &value, unsigned long long seed)
+{
+	return TBMeshFile::computeChecksum(&value, sizeof(value), seed);
+}
+
+unsigned long long hashCircle(const Circle3f &circle, unsigned long long seed)
+{
+	float values[4] = { circle.Center.X(), circle.Center.Y(), circle.Center.Z(), circle.Radius };
+	return TBMeshFile::computeChecksum(values, sizeof(values), seed);
+}
+
+}
+
+template <class T>
+TBRotorModel::Stage<T>::Stage()
+	: mGeneration(0)
+{
+}
+
+template <class T>
+T &TBRotorModel::Stage<T>::get(Key key, bool &built)
+{
+	Entry &entry = mEntries[key];
+	built = !entry.value;
+	if (built) {
+		entry.value.reset(new T());
+	}
+	entry.generation = mGeneration;
+	return *entry.value;
+}
+
+template <class T>
+void TBRotorModel::Stage<T>::finish()
+{
+	typename std::unordered_map<Key, Entry>::iterator entry = mEntries.begin();
+	while (entry != mEntries.end()) {
+		if (entry->second.generation < mGeneration - 1) {
+			entry = mEntries.erase(entry);
+		} else {
+			++entry;
+		}
+	}
+	mGeneration++;
+}
+
+template <class T>
+void TBRotorModel::Stage<T>::clear()
+{
+	mEntries.clear();
+}
+
+TBRotorModel::TBRotorModel()
+{
+	memset(&mStats, 0, sizeof(mStats));
+}
+
+TBRotorModel::~TBRotorModel()
+{
+}
+
+const TBRotorModel::Stats &TBRotorModel::getStats() const
+{
+	return mStats;
+}
+
+void TBRotorModel::clear()
+{
+	mProfiles.clear();
+	mSections.clear();
+	mWings.clear();
+	mBodies.clear();
+	mPlacedWings.clear();
+	mUnions.clear();
+}
+
+TBBoolean::Status TBRotorModel::update(const TBRotorParams &params, float tolerance, TBMesh &result)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	TBRotor rotor(params);
+	TBThreadPool &pool = TBThreadPool::getShared();
+	TBBoolean::Validation validation = TBBoolean::getValidation();
+	int numSections = params.numSteps + 1;
+	memset(&mStats, 0, sizeof(mStats));
+
+	// Profiles, by their circles. Entries built in this pass are filled in
+	// afterwards, in parallel; steps with the same circles share one.
+	std::vector<TBWingProfile *> profiles(numSections);
+	std::vector<Key> profileKeys(numSections);
+	std::vector<int> newProfiles;
+	for (int step=0; step<numSections; step++) {
+		std::vector<Circle3f> circles;
+		rotor.getSectionCircles(step, circles);
+		Key key = hashValue(tolerance, 14695981039346656037ULL);
+		for (size_t k=0; k<circles.size(); k++) {
+			key = hashCircle(circles[k], key);
+		}
+		bool built;
+		profiles[step] = &mProfiles.get(key, built);
+		profileKeys[step] = key;
+		if (built) {
+			newProfiles.push_back(step);
+		}
+	}
+	pool.parallelFor(newProfiles.size(), [&](int i) {
+		int step = newProfiles[i];
+		rotor.createProfile(step, tolerance, *profiles[step]);
+	});
+	mStats.numProfilesBuilt = newProfiles.size();
+	mStats.numProfiles = numSections;
+
+	// Sections, by their profile, the shared layout and their height.
+	std::vector<int> counts;
+	int numSamples;
+	rotor.getSampleLayout(std::vector<const TBWingProfile *>(profiles.begin(), profiles.end()),
+						  counts, numSamples);
+	Key layoutKey = hashValue(numSamples, 14695981039346656037ULL);
+	if (!counts.empty()) {
+		layoutKey = TBMeshFile::computeChecksum(&counts[0], counts.size() * sizeof(int), layoutKey);
+	}
+	std::vector<std::vector<Vector3f> *> sections(numSections);
+	std::vector<int> newSections;
+	Key wingKey = hashValue(validation, 14695981039346656037ULL);
+	for (int step=0; step<numSections; step++) {
+		float height = step * (params.height / params.numSteps);
+		Key key = hashValue(height, hashValue(layoutKey, profileKeys[step]));
+		bool built;
+		sections[step] = &mSections.get(key, built);
+		if (built) {
+			newSections.push_back(step);
+		}
+		wingKey = hashValue(key, wingKey);
+	}
+	pool.parallelFor(newSections.size(), [&](int i) {
+		int step = newSections[i];
+		rotor.createSection(*profiles[step], step, counts, numSamples, *sections[step]);
+	});
+	mStats.numSectionsBuilt = newSections.size();
+	mStats.numSections = numSections;
+
+	// The wing, checked once here: placing it only moves it, so the placed
+	// wings are as valid as it is.
+	bool built;
+	Wing &wing = mWings.get(wingKey, built);
+	if (built) {
+		std::vector<std::vector<Vector3f> > rings(numSections);
+		for (int step=0; step<numSections; step++) {
+			rings[step] = *sections[step];
+		}
+		wing.mesh.loft(&rings[0], numSections);
+		wing.status = TBBoolean::validate(wing.mesh, validation);
+	}
+	mStats.wingBuilt = built;
+
+	Key bodyKey = hashValue(validation, 14695981039346656037ULL);
+	bodyKey = hashValue(params.bodyRadius, bodyKey);
+	bodyKey = hashValue(params.bodyHalfHeight, bodyKey);
+	bodyKey = hashValue(tolerance, bodyKey);
+	Body &body = mBodies.get(bodyKey, built);
+	if (built) {
+		TBMesh mesh;
+		rotor.createBody(mesh, tolerance);
+		rotor.placeBody(mesh);
+		body.status = TBBoolean::validate(mesh, validation);
+		body.operand.load(mesh);
+		body.operand.getBvh();
+	}
+	mStats.bodyBuilt = built;
+
+	// Placed wings, by the wing and where it goes.
+	std::vector<TBNativeOperand *> placedWings(params.numWings);
+	std::vector<const TBNativeOperand *> operands(1, &body.operand);
+	std::vector<Key> operandKeys(1, bodyKey);
+	std::vector<int> newWings;
+	for (int i=0; i<params.numWings; i++) {
+		Key key = hashValue(params.wingPitch, wingKey);
+		key = hashValue(params.wingOffset, key);
+		key = hashValue(i * Mathf::TWO_PI / params.numWings, key);
+		placedWings[i] = &mPlacedWings.get(key, built);
+		operands.push_back(placedWings[i]);
+		operandKeys.push_back(key);
+		if (built) {
+			newWings.push_back(i);
+		}
+	}
+	pool.parallelFor(newWings.size(), [&](int n) {
+		int i = newWings[n];
+		TBMesh *placed = wing.mesh.clone();
+		rotor.placeWing(*placed, i);
+		placedWings[i]->load(*placed);
+		placedWings[i]->getBvh();
+		delete0(placed);
+	});
+	mStats.numWingsPlaced = newWings.size();
+	mStats.numWings = params.numWings;
+
+	mProfiles.finish();
+	mSections.finish();
+	mWings.finish();
+	mBodies.finish();
+	mPlacedWings.finish();
+
+	TBBoolean::Status status = body.status != TBBoolean::STATUS_OK ? body.status : wing.status;
+	if (status == TBBoolean::STATUS_OK) {
+		status = TBBoolean::unionAll(operands, operandKeys, mUnions, result);
+		mStats.numUnionsComputed = mUnions.getNumComputed();
+		mStats.numUnions = mUnions.getNumComputed() + mUnions.getNumReused();
+	}
+	mStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return status;
+}
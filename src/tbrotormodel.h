@@ -0,0 +1,106 @@
+#ifndef TBROTORMODEL_H
+#define TBROTORMODEL_H
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "tbrotor.h"
+#include "tbnativeboolean.h"
+
+// Rotor geometry kept from one set of parameters to the next, for editing
+// a rotor interactively. Every stage of the pipeline records a hash of its
+// inputs and update() only rebuilds the stages whose inputs changed:
+//   profiles, per section: the interpolated circles and the tolerance
+//   sections: the profile, the sample layout they share and the height
+//   wing: its sections
+//   body: its radius, half height and the tolerance
+//   placed wings, loaded as boolean operands: the wing, pitch, offset and
+//   the turn of each
+//   union pairs: their two operands, through TBUnionCache
+// Stages are looked up by key rather than by position, so a section whose
+// circles come back, as every other one does when the steps double, is
+// reused as well. The stages of the last two updates are kept, so undoing
+// an edit rebuilds nothing.
+class TBRotorModel
+{
+public:
+	// What the last update() rebuilt, out of how many.
+	struct Stats
+	{
+		int numProfilesBuilt;
+		int numProfiles;
+		int numSectionsBuilt;
+		int numSections;
+		bool wingBuilt;
+		bool bodyBuilt;
+		int numWingsPlaced;
+		int numWings;
+		int numUnionsComputed;
+		int numUnions;
+		double seconds;
+	};
+
+	TBRotorModel();
+	~TBRotorModel();
+
+	// Appends the rotor of params, sampled within tolerance, to result. The
+	// outcome matches TBRotor::createMesh(), including its failures.
+	TBBoolean::Status update(const TBRotorParams &params, float tolerance, TBMesh &result);
+	const Stats &getStats() const;
+	// Drops every stage, so the next update builds them all.
+	void clear();
+
+private:
+	TBRotorModel(const TBRotorModel &);
+	TBRotorModel &operator=(const TBRotorModel &);
+
+	typedef unsigned long long Key;
+
+	// Entries of one stage by key, with the update that last used them.
+	template <class T>
+	class Stage
+	{
+	public:
+		Stage();
+
+		// The entry for key, kept from an earlier update or, when built is
+		// set, new and still to be built.
+		T &get(Key key, bool &built);
+		// Ends an update, dropping the entries neither it nor the one
+		// before used.
+		void finish();
+		void clear();
+
+	private:
+		struct Entry
+		{
+			std::unique_ptr<T> value;
+			int generation;
+		};
+
+		std::unordered_map<Key, Entry> mEntries;
+		int mGeneration;
+	};
+
+	struct Wing
+	{
+		TBMesh mesh;
+		TBBoolean::Status status;
+	};
+
+	struct Body
+	{
+		TBNativeOperand operand;
+		TBBoolean::Status status;
+	};
+
+	Stage<TBWingProfile> mProfiles;
+	Stage<std::vector<Vector3f> > mSections;
+	Stage<Wing> mWings;
+	Stage<Body> mBodies;
+	Stage<TBNativeOperand> mPlacedWings;
+	TBUnionCache mUnions;
+	Stats mStats;
+};
+
+#endif
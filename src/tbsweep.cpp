@@ -0,0 +1,465 @@
+#include "tbsweep.h"
+#include "tbmeshexporter.h"
+#include "tbmeshfile.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Memory a worker keeps from one job to the next.
+struct TBSweep::Scratch
+{
+	// Created on the first export; its buffers are megabytes.
+	std::unique_ptr<TBMeshExporter> exporter;
+};
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double secondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Relative cost of a job, only used to order them. Sections grow with the
+// steps, and the samples of a section with sqrt(radius / tolerance).
+double estimateCost(const TBSweepJob &job)
+{
+	const TBRotorParams &params = job.params;
+	if (!job.error.empty() || params.chordTolerance <= 0.0f) {
+		return 0.0;
+	}
+	double samples = 0.0;
+	for (size_t i=0; i<params.beginCircles.size(); i++) {
+		samples += sqrt(fabs(params.beginCircles[i].Radius) / params.chordTolerance);
+	}
+	return params.numWings * (params.numSteps + 1.0) * samples;
+}
+
+// Area and enclosed volume, the latter from the divergence theorem, so it
+// is only meaningful for closed meshes.
+void measure(const TBMesh &mesh, TBSweepResult &result)
+{
+	const std::vector<Vector3f> &vertices = mesh.getVertices();
+	const std::vector<int> &indices = mesh.getIndices();
+	result.numVertices = vertices.size();
+	result.numTriangles = indices.size() / 3;
+
+	double area = 0.0, volume = 0.0;
+	for (int t=0; t<result.numTriangles; t++) {
+		const Vector3f &v0 = vertices[indices[t*3]];
+		const Vector3f &v1 = vertices[indices[t*3 + 1]];
+		const Vector3f &v2 = vertices[indices[t*3 + 2]];
+		area += 0.5 * (v1 - v0).Cross(v2 - v0).Length();
+		volume += v0.Dot(v1.Cross(v2)) / 6.0;
+	}
+	result.area = (float)area;
+	result.volume = (float)volume;
+
+	for (int k=0; k<3; k++) {
+		result.boundsMin[k] = vertices.empty() ? 0.0f : vertices[0][k];
+		result.boundsMax[k] = result.boundsMin[k];
+	}
+	for (size_t i=1; i<vertices.size(); i++) {
+		for (int k=0; k<3; k++) {
+			result.boundsMin[k] = std::min(result.boundsMin[k], vertices[i][k]);
+			result.boundsMax[k] = std::max(result.boundsMax[k], vertices[i][k]);
+		}
+	}
+}
+
+// The parameter lines one axis value stands for.
+std::string axisText(const std::string &key, const std::string &value)
+{
+	std::string text = key + " ";
+	for (size_t i=0; i<value.size(); i++) {
+		if (value[i] == ',') {
+			text += ' ';
+		} else if (value[i] == ';') {
+			text += "\n" + key + " ";
+		} else {
+			text += value[i];
+		}
+	}
+	return text + "\n";
+}
+
+}
+
+TBSweep::TBSweep(int numThreads)
+	: mNumThreads(numThreads), mIsolate(true), mTimeout(300.0)
+{
+	if (mNumThreads < 0) {
+		mNumThreads = std::max((int)std::thread::hardware_concurrency() - 1, 0);
+	}
+}
+
+TBSweep::~TBSweep()
+{
+}
+
+void TBSweep::setIsolation(bool isolate)
+{
+	mIsolate = isolate;
+}
+
+bool TBSweep::getIsolation() const
+{
+	return mIsolate;
+}
+
+void TBSweep::setTimeout(double seconds)
+{
+	mTimeout = seconds;
+}
+
+double TBSweep::getTimeout() const
+{
+	return mTimeout;
+}
+
+void TBSweep::expandGrid(const TBRotorParams &base, const std::vector<TBSweepAxis> &axes,
+						 std::vector<TBSweepJob> &jobs)
+{
+	for (size_t a=0; a<axes.size(); a++) {
+		if (axes[a].values.empty()) {
+			return;
+		}
+	}
+
+	// Counts through the combinations with the last axis changing fastest.
+	std::vector<size_t> choice(axes.size(), 0);
+	while (true) {
+		TBSweepJob job;
+		job.params = base;
+		std::string text;
+		for (size_t a=0; a<axes.size(); a++) {
+			const std::string &value = axes[a].values[choice[a]];
+			text += axisText(axes[a].key, value);
+			job.name += (a ? " " : "") + axes[a].key + "=" + value;
+		}
+		job.params.parse(text, job.name.c_str(), &job.error);
+		jobs.push_back(job);
+
+		size_t a = axes.size();
+		while (a > 0 && ++choice[a - 1] == axes[a - 1].values.size()) {
+			choice[--a] = 0;
+		}
+		if (a == 0) {
+			return;
+		}
+	}
+}
+
+bool TBSweep::load(const char *path, std::vector<TBSweepJob> &jobs, std::string *error)
+{
+	std::ifstream file(path);
+	if (!file) {
+		if (error) {
+			*error = std::string(path) + ": cannot open the file";
+		}
+		return false;
+	}
+
+	// The vary lines are blanked rather than dropped, so parse() still
+	// reports the right line numbers.
+	std::vector<TBSweepAxis> axes;
+	std::string text, line;
+	while (std::getline(file, line)) {
+		std::istringstream fields(line.substr(0, line.find('#')));
+		std::string keyword;
+		if (fields >> keyword && keyword == "vary") {
+			TBSweepAxis axis;
+			fields >> axis.key;
+			std::string value;
+			while (fields >> value) {
+				axis.values.push_back(value);
+			}
+			if (axis.values.empty()) {
+				if (error) {
+					*error = std::string(path) + ": vary " + axis.key + " has no values";
+				}
+				return false;
+			}
+			axes.push_back(axis);
+			line.clear();
+		}
+		text += line + "\n";
+	}
+
+	TBRotorParams base;
+	if (!base.parse(text, path, error)) {
+		return false;
+	}
+	size_t first = jobs.size();
+	expandGrid(base, axes, jobs);
+	for (size_t i=first; i<jobs.size(); i++) {
+		jobs[i].name = jobs[i].name.empty() ? path : std::string(path) + " " + jobs[i].name;
+		if (!jobs[i].error.empty()) {
+			jobs[i].error = std::string(path) + " " + jobs[i].error;
+		}
+	}
+	return true;
+}
+
+int TBSweep::run(const std::vector<TBSweepJob> &jobs, const Report &report)
+{
+	std::vector<double> costs(jobs.size());
+	std::vector<int> order(jobs.size());
+	for (size_t i=0; i<jobs.size(); i++) {
+		costs[i] = estimateCost(jobs[i]);
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return costs[a] > costs[b]; });
+
+	std::mutex reportMutex;
+	int numFailed = 0;
+	Finish finish = [&](int index, TBSweepResult &result) {
+		result.job = index;
+		std::lock_guard<std::mutex> lock(reportMutex);
+		if (result.outcome != TBSweepResult::OUTCOME_OK) {
+			numFailed++;
+		}
+		if (report) {
+			report(jobs[index], result);
+		}
+	};
+	if (mIsolate) {
+		runIsolated(jobs, order, finish);
+	} else {
+		runPooled(jobs, order, finish);
+	}
+	return numFailed;
+}
+
+void TBSweep::runPooled(const std::vector<TBSweepJob> &jobs, const std::vector<int> &order,
+						const Finish &finish)
+{
+	if (!mPool) {
+		mPool.reset(new TBThreadPool(mNumThreads));
+		for (int i=0; i<=mNumThreads; i++) {
+			mScratch.push_back(std::unique_ptr<Scratch>(new Scratch()));
+		}
+	}
+	mPool->parallelFor(jobs.size(), [&](int i) {
+		int index = order[i];
+		int worker = TBThreadPool::getThreadIndex();
+		assertion(worker < (int)mScratch.size(), "Sweeps must run from a thread outside any pool.\n");
+
+		Clock::time_point start = Clock::now();
+		TBSweepResult result = runJob(jobs[index], *mScratch[worker]);
+		result.worker = worker;
+		result.totalSeconds = secondsSince(start);
+		finish(index, result);
+	});
+}
+
+TBSweepResult TBSweep::runJob(const TBSweepJob &job, Scratch &scratch) const
+{
+	TBSweepResult result;
+	memset(&result, 0, sizeof(result));
+	if (!job.error.empty() || !job.params.check().empty()) {
+		result.outcome = TBSweepResult::OUTCOME_INVALID;
+		return result;
+	}
+
+	Clock::time_point start = Clock::now();
+	TBMesh mesh;
+	result.booleanStatus = TBRotor(job.params).createMesh(mesh, job.params.chordTolerance);
+	result.buildSeconds = secondsSince(start);
+	if (result.booleanStatus != TBBoolean::STATUS_OK) {
+		result.outcome = TBSweepResult::OUTCOME_BOOLEAN_FAILED;
+		return result;
+	}
+	measure(mesh, result);
+
+	if (!job.exportPath.empty()) {
+		start = Clock::now();
+		const char *path = job.exportPath.c_str();
+		size_t length = job.exportPath.size();
+		bool saved;
+		TBMeshExporter::Format format;
+		if (length >= 4 && job.exportPath.compare(length - 4, 4, ".tbm") == 0) {
+			saved = TBMeshFile::save(path, mesh) == TBMeshFile::STATUS_OK;
+		} else if (TBMeshExporter::getFormat(path, format)) {
+			if (!scratch.exporter) {
+				scratch.exporter.reset(new TBMeshExporter());
+			}
+			saved = scratch.exporter->open(path, format) == TBMeshExporter::STATUS_OK;
+			if (saved) {
+				scratch.exporter->write(mesh);
+				saved = scratch.exporter->close() == TBMeshExporter::STATUS_OK;
+			}
+		} else {
+			saved = false;
+		}
+		result.exportSeconds = secondsSince(start);
+		if (!saved) {
+			result.outcome = TBSweepResult::OUTCOME_EXPORT_FAILED;
+			return result;
+		}
+	}
+
+	result.outcome = TBSweepResult::OUTCOME_OK;
+	return result;
+}
+
+void TBSweep::runIsolated(const std::vector<TBSweepJob> &jobs, const std::vector<int> &order,
+						  const Finish &finish)
+{
+	// A running process, by the slot it was started in.
+	struct Child
+	{
+		pid_t pid;
+		int channel;
+		int job;
+		Clock::time_point start;
+		TBSweepResult result;
+		size_t received;
+	};
+	// Scratch for the jobs that run here; each child works on its own
+	// copy and drops it when it exits.
+	Scratch scratch;
+	std::vector<Child> slots(mNumThreads + 1);
+	for (size_t k=0; k<slots.size(); k++) {
+		slots[k].pid = 0;
+	}
+	int numRunning = 0;
+	size_t next = 0;
+
+	while (next < order.size() || numRunning > 0) {
+		// Fill the free slots. Rejected jobs need no process, and a job
+		// that cannot get one runs here instead.
+		for (size_t k=0; k<slots.size(); k++) {
+			Child &child = slots[k];
+			while (child.pid == 0 && next < order.size()) {
+				int index = order[next++];
+				int channel[2];
+				child.start = Clock::now();
+				pid_t pid = -1;
+				if (jobs[index].error.empty() && pipe2(channel, O_CLOEXEC) == 0) {
+					pid = fork();
+					if (pid < 0) {
+						::close(channel[0]);
+						::close(channel[1]);
+					}
+				}
+				if (pid < 0) {
+					TBSweepResult result = runJob(jobs[index], scratch);
+					result.worker = k;
+					result.totalSeconds = secondsSince(child.start);
+					finish(index, result);
+					continue;
+				}
+
+				if (pid == 0) {
+					// The child has only this thread; the pools' workers stayed in
+					// the parent. _exit() leaves the parent's stdio buffers alone.
+					::close(channel[0]);
+					for (size_t other=0; other<slots.size(); other++) {
+						if (other != k && slots[other].pid > 0) {
+							::close(slots[other].channel);
+						}
+					}
+					TBThreadPool::serializeCurrentThread();
+					TBSweepResult result = runJob(jobs[index], scratch);
+					const char *data = (const char *)&result;
+					size_t left = sizeof(result);
+					while (left > 0) {
+						ssize_t written = write(channel[1], data, left);
+						if (written <= 0 && errno != EINTR) {
+							_exit(1);
+						}
+						if (written > 0) {
+							data += written;
+							left -= written;
+						}
+					}
+					_exit(0);
+				}
+
+				::close(channel[1]);
+				child.pid = pid;
+				child.channel = channel[0];
+				child.job = index;
+				child.received = 0;
+				numRunning++;
+			}
+		}
+		if (numRunning == 0) {
+			continue;
+		}
+
+		// Wait for a result, an exit or the first deadline.
+		std::vector<pollfd> fds;
+		std::vector<int> fdSlots;
+		int wait = -1;
+		for (size_t k=0; k<slots.size(); k++) {
+			if (slots[k].pid == 0) {
+				continue;
+			}
+			pollfd fd = { slots[k].channel, POLLIN, 0 };
+			fds.push_back(fd);
+			fdSlots.push_back(k);
+			if (mTimeout > 0.0) {
+				double left = mTimeout - secondsSince(slots[k].start);
+				int milliseconds = left > 0.0 ? (int)ceil(left * 1e3) : 0;
+				wait = wait < 0 ? milliseconds : std::min(wait, milliseconds);
+			}
+		}
+		// On failure no revents are set and only the deadlines are checked.
+		poll(&fds[0], fds.size(), wait);
+
+		for (size_t f=0; f<fds.size(); f++) {
+			Child &child = slots[fdSlots[f]];
+			bool done = false;
+			bool timedOut = false;
+			if (fds[f].revents != 0) {
+				char *data = (char *)&child.result;
+				ssize_t count = read(child.channel, data + child.received,
+									 sizeof(child.result) - child.received);
+				if (count > 0) {
+					child.received += count;
+				}
+				done = count == 0 || (count < 0 && errno != EINTR && errno != EAGAIN);
+			}
+			if (!done && mTimeout > 0.0 && secondsSince(child.start) >= mTimeout) {
+				kill(child.pid, SIGKILL);
+				done = timedOut = true;
+			}
+			if (!done) {
+				continue;
+			}
+
+			::close(child.channel);
+			int status = 0;
+			while (waitpid(child.pid, &status, 0) < 0 && errno == EINTR) {
+			}
+			TBSweepResult &result = child.result;
+			if (timedOut) {
+				memset(&result, 0, sizeof(result));
+				result.outcome = TBSweepResult::OUTCOME_TIMEOUT;
+			} else if (child.received < sizeof(result) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+				memset(&result, 0, sizeof(result));
+				result.outcome = TBSweepResult::OUTCOME_CRASHED;
+				result.signal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+			}
+			result.worker = fdSlots[f];
+			result.totalSeconds = secondsSince(child.start);
+			child.pid = 0;
+			numRunning--;
+			finish(child.job, result);
+		}
+	}
+}
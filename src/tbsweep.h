@@ -0,0 +1,138 @@
+#ifndef TBSWEEP_H
+#define TBSWEEP_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "tbrotor.h"
+#include "tbthreadpool.h"
+
+class TBMeshExporter;
+
+// A rotor to build, with the file to export it to; an empty exportPath
+// only measures it. A job with an error is reported invalid unbuilt.
+struct TBSweepJob
+{
+	std::string name;
+	TBRotorParams params;
+	std::string exportPath;
+	std::string error;
+};
+
+// Values one parameter takes across a grid. Each value is the text of the
+// key's arguments; ',' stands for a space and ';' starts another line of
+// the same key, so "0,0,1;3,0,0.5" gives two begin_circle lines.
+struct TBSweepAxis
+{
+	std::string key;
+	std::vector<std::string> values;
+};
+
+// Outcome of one job. Plain data, so isolated jobs send it back through a
+// pipe as is.
+struct TBSweepResult
+{
+	enum Outcome
+	{
+		OUTCOME_OK,
+		// The parameters were rejected before building.
+		OUTCOME_INVALID,
+		// A boolean operand failed validation; see booleanStatus.
+		OUTCOME_BOOLEAN_FAILED,
+		OUTCOME_EXPORT_FAILED,
+		// The isolated process died, on signal if it is not 0.
+		OUTCOME_CRASHED,
+		// The isolated process ran past the timeout and was killed.
+		OUTCOME_TIMEOUT
+	};
+
+	int job;
+	int worker;
+	Outcome outcome;
+	TBBoolean::Status booleanStatus;
+	int signal;
+
+	int numVertices;
+	int numTriangles;
+	float area;
+	float volume;
+	float boundsMin[3];
+	float boundsMax[3];
+
+	double buildSeconds;
+	double exportSeconds;
+	// From the job's start to its result, process creation included.
+	double totalSeconds;
+};
+
+// Builds many rotors on a thread pool.
+//
+// Jobs start largest estimated job first, so the long jobs start early and
+// the short ones fill in behind them. Each job builds serially.
+//
+// With isolation, on by default, every job runs in a process of its own: a
+// crash or a failed GTS assertion only fails that job, and the parent stays
+// intact for the others. The calling thread forks the processes, one at a
+// time for each thread the sweep may use, and waits for their results; no
+// other thread of the sweep runs while it forks. A process still running
+// after the timeout is killed. Scratch is then per process: each one starts
+// from a copy of the calling thread's.
+//
+// Without isolation the sweep starts a thread pool, whose workers claim the
+// jobs one at a time from a shared counter, and each keeps its own scratch.
+class TBSweep
+{
+public:
+	typedef std::function<void(const TBSweepJob &job, const TBSweepResult &result)> Report;
+
+	// numThreads as for TBThreadPool, besides the calling thread.
+	explicit TBSweep(int numThreads = -1);
+	~TBSweep();
+
+	void setIsolation(bool isolate);
+	bool getIsolation() const;
+	// Seconds an isolated job may run, 300 by default; 0 waits for ever.
+	// Jobs run without isolation cannot be stopped.
+	void setTimeout(double seconds);
+	double getTimeout() const;
+
+	// Appends a job for every combination of one value per axis, applied
+	// to base in axis order. Jobs are named after their values.
+	static void expandGrid(const TBRotorParams &base, const std::vector<TBSweepAxis> &axes,
+						   std::vector<TBSweepJob> &jobs);
+
+	// Reads a parameter file in which "vary <key> <value>..." lines make
+	// the axes of a grid, and appends its jobs. Job names start with the
+	// file name.
+	static bool load(const char *path, std::vector<TBSweepJob> &jobs, std::string *error = NULL);
+
+	// Runs the jobs and calls report, one call at a time, as each one
+	// finishes. Returns the number of jobs that did not end OK.
+	int run(const std::vector<TBSweepJob> &jobs, const Report &report);
+
+private:
+	TBSweep(const TBSweep &);
+	TBSweep &operator=(const TBSweep &);
+
+	struct Scratch;
+
+	// Calls finish(index, result) for every job, by its index.
+	typedef std::function<void(int index, TBSweepResult &result)> Finish;
+
+	TBSweepResult runJob(const TBSweepJob &job, Scratch &scratch) const;
+	void runPooled(const std::vector<TBSweepJob> &jobs, const std::vector<int> &order,
+				   const Finish &finish);
+	void runIsolated(const std::vector<TBSweepJob> &jobs, const std::vector<int> &order,
+					 const Finish &finish);
+
+	int mNumThreads;
+	bool mIsolate;
+	double mTimeout;
+	// Only made for runs without isolation, then kept for later runs.
+	std::unique_ptr<TBThreadPool> mPool;
+	// One per worker, plus one for the calling thread.
+	std::vector<std::unique_ptr<Scratch> > mScratch;
+};
+
+#endif
@@ -0,0 +1,127 @@
+#include "tbthreadpool.h"
+
+namespace {
+
+// Set while the current thread runs a parallelFor body.
+thread_local bool sInsideJob = false;
+thread_local bool sSerial = false;
+thread_local int sThreadIndex = 0;
+
+}
+
+TBThreadPool::TBThreadPool(int numThreads)
+{
+	mBody = NULL;
+	mCount = 0;
+	mNext = 0;
+	mActive = 0;
+	mGeneration = 0;
+	mStop = false;
+
+	if (numThreads < 0) {
+		numThreads = (int)std::thread::hardware_concurrency() - 1;
+	}
+	for (int i=0; i<numThreads; i++) {
+		mThreads.push_back(std::thread(&TBThreadPool::workerLoop, this, i + 1));
+	}
+}
+
+TBThreadPool::~TBThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for (int i=0; i<(int)mThreads.size(); i++) {
+		mThreads[i].join();
+	}
+}
+
+int TBThreadPool::getNumThreads() const
+{
+	return mThreads.size();
+}
+
+TBThreadPool &TBThreadPool::getShared()
+{
+	static TBThreadPool pool;
+	return pool;
+}
+
+int TBThreadPool::getThreadIndex()
+{
+	return sThreadIndex;
+}
+
+void TBThreadPool::serializeCurrentThread()
+{
+	sSerial = true;
+}
+
+void TBThreadPool::runJob()
+{
+	sInsideJob = true;
+	for (int i = mNext++; i < mCount; i = mNext++) {
+		(*mBody)(i);
+	}
+	sInsideJob = false;
+}
+
+void TBThreadPool::workerLoop(int index)
+{
+	sThreadIndex = index;
+	unsigned int seen = 0;
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true) {
+		while (!mStop && mGeneration == seen) {
+			mWake.wait(lock);
+		}
+		if (mStop) {
+			return;
+		}
+		seen = mGeneration;
+
+		lock.unlock();
+		runJob();
+		lock.lock();
+
+		// Every worker checks in once per job, so the body stays valid until
+		// the last one has left runJob().
+		if (--mActive == 0) {
+			mDone.notify_all();
+		}
+	}
+}
+
+void TBThreadPool::parallelFor(int count, const std::function<void(int)> &body)
+{
+	if (count <= 0) {
+		return;
+	}
+	if (mThreads.empty() || count == 1 || sInsideJob || sSerial) {
+		for (int i=0; i<count; i++) {
+			body(i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> job(mJobMutex);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mBody = &body;
+		mCount = count;
+		mNext = 0;
+		mActive = mThreads.size();
+		mGeneration++;
+	}
+	mWake.notify_all();
+
+	runJob();
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (mActive > 0) {
+		mDone.wait(lock);
+	}
+	mBody = NULL;
+}
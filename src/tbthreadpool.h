@@ -0,0 +1,65 @@
+#ifndef TBTHREADPOOL_H
+#define TBTHREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Fixed set of worker threads running index ranges.
+//
+// parallelFor() hands out the indices one at a time from a shared counter,
+// so uneven items balance themselves, and the calling thread works on the
+// range too. Calls made from inside a running body execute serially on the
+// calling thread, which keeps nested parallel code from deadlocking.
+class TBThreadPool
+{
+	public:
+		// numThreads < 0 picks one worker per hardware thread besides the
+		// caller; 0 runs everything on the calling thread.
+		TBThreadPool(int numThreads = -1);
+		~TBThreadPool();
+
+		int getNumThreads() const;
+
+		// Calls body(i) for every i in [0, count) and returns when all are
+		// done. The order and the thread of each call are unspecified.
+		void parallelFor(int count, const std::function<void(int)> &body);
+
+		// Pool shared by the mesh code, created on first use.
+		static TBThreadPool &getShared();
+
+		// 1 to getNumThreads() on the workers of a pool and 0 on any other
+		// thread, so a body called from a plain thread can pick per-thread
+		// scratch by it.
+		static int getThreadIndex();
+
+		// Every later parallelFor on the calling thread runs serially. For
+		// processes forked while a pool runs, which keep none of its workers.
+		static void serializeCurrentThread();
+
+	private:
+		TBThreadPool(const TBThreadPool &);
+		TBThreadPool &operator=(const TBThreadPool &);
+
+		void workerLoop(int index);
+		void runJob();
+
+	private:
+		std::vector<std::thread> mThreads;
+		std::mutex mJobMutex;
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		std::condition_variable mDone;
+
+		const std::function<void(int)> *mBody;
+		int mCount;
+		std::atomic<int> mNext;
+		int mActive;
+		unsigned int mGeneration;
+		bool mStop;
+};
+
+#endif
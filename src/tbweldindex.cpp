@@ -0,0 +1,163 @@
+#include "tbweldindex.h"
+#include <climits>
+#include <cmath>
+
+const float TBWeldIndex::DEFAULT_TOLERANCE = 0.0001f;
+
+TBWeldIndex::TBWeldIndex(float tolerance)
+{
+	mCount = 0;
+	mMask = 0;
+	setTolerance(tolerance);
+}
+
+TBWeldIndex::~TBWeldIndex()
+{
+
+}
+
+void TBWeldIndex::setTolerance(float tolerance)
+{
+	// The table is keyed by cell, so it is only valid for one tolerance.
+	clear();
+	mTolerance = tolerance > 0 ? tolerance : DEFAULT_TOLERANCE;
+	mInvCellSize = 0.125f / mTolerance;
+}
+
+float TBWeldIndex::getTolerance() const
+{
+	return mTolerance;
+}
+
+void TBWeldIndex::clear()
+{
+	mSlots.clear();
+	mCount = 0;
+	mMask = 0;
+}
+
+int TBWeldIndex::size() const
+{
+	return mCount;
+}
+
+void TBWeldIndex::reserve(int numVertices)
+{
+	// Keep the load factor at or below one half.
+	int numSlots = 16;
+	while (numSlots < numVertices * 2) {
+		numSlots *= 2;
+	}
+	if (numSlots > (int)mSlots.size()) {
+		rehash(numSlots);
+	}
+}
+
+int TBWeldIndex::cellOf(float value) const
+{
+	// Clamp well inside the int range so neighbour loops cannot overflow.
+	const double limit = (double)(INT_MAX / 2);
+	double cell = std::floor((double)value * mInvCellSize);
+	if (cell < -limit) {
+		return -(int)limit;
+	}
+	if (cell > limit) {
+		return (int)limit;
+	}
+	return (int)cell;
+}
+
+unsigned int TBWeldIndex::hashCell(int x, int y, int z)
+{
+	unsigned int h = (unsigned int)x * 0x9E3779B1u;
+	h ^= (unsigned int)y * 0x85EBCA77u;
+	h ^= (unsigned int)z * 0xC2B2AE3Du;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	return h;
+}
+
+void TBWeldIndex::rehash(int numSlots)
+{
+	std::vector<Slot> old;
+	old.swap(mSlots);
+
+	Slot empty;
+	empty.x = empty.y = empty.z = 0;
+	empty.index = -1;
+	mSlots.assign(numSlots, empty);
+	mMask = (unsigned int)numSlots - 1;
+
+	std::vector<Slot>::const_iterator it = old.begin();
+	for (; it != old.end(); it++) {
+		if (it->index < 0) {
+			continue;
+		}
+		unsigned int i = hashCell(it->x, it->y, it->z) & mMask;
+		while (mSlots[i].index >= 0) {
+			i = (i + 1) & mMask;
+		}
+		mSlots[i] = *it;
+	}
+}
+
+void TBWeldIndex::insert(const Vector3f &point, int index)
+{
+	if ((mCount + 1) * 2 > (int)mSlots.size()) {
+		rehash(mSlots.empty() ? 16 : (int)mSlots.size() * 2);
+	}
+
+	Slot slot;
+	slot.x = cellOf(point.X());
+	slot.y = cellOf(point.Y());
+	slot.z = cellOf(point.Z());
+	slot.index = index;
+
+	unsigned int i = hashCell(slot.x, slot.y, slot.z) & mMask;
+	while (mSlots[i].index >= 0) {
+		i = (i + 1) & mMask;
+	}
+	mSlots[i] = slot;
+	mCount++;
+}
+
+int TBWeldIndex::find(const Vector3f &point, const Vector3f *vertices) const
+{
+	if (mCount == 0) {
+		return -1;
+	}
+
+	// Cells are wider than the tolerance box around the point, so the box
+	// covers one or two cells on each axis.
+	int lo[3], hi[3];
+	for (int k = 0; k < 3; k++) {
+		lo[k] = cellOf(point[k] - mTolerance);
+		hi[k] = cellOf(point[k] + mTolerance);
+	}
+
+	int best = -1;
+	for (int x = lo[0]; x <= hi[0]; x++) {
+		for (int y = lo[1]; y <= hi[1]; y++) {
+			for (int z = lo[2]; z <= hi[2]; z++) {
+				unsigned int i = hashCell(x, y, z) & mMask;
+				for (; mSlots[i].index >= 0; i = (i + 1) & mMask) {
+					const Slot &slot = mSlots[i];
+					if (slot.x != x || slot.y != y || slot.z != z) {
+						continue;
+					}
+					if (best >= 0 && slot.index >= best) {
+						continue;
+					}
+					const Vector3f &v = vertices[slot.index];
+					if (std::fabs(v.X() - point.X()) <= mTolerance &&
+						std::fabs(v.Y() - point.Y()) <= mTolerance &&
+						std::fabs(v.Z() - point.Z()) <= mTolerance) {
+						best = slot.index;
+					}
+				}
+			}
+		}
+	}
+	return best;
+}
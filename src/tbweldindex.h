@@ -0,0 +1,58 @@
+#ifndef TBWELDINDEX_H
+#define TBWELDINDEX_H
+
+#include <vector>
+#include "Wm5Vector3.h"
+
+using namespace Wm5;
+
+// Spatial hash used to weld coincident vertices.
+//
+// Positions are quantized to an integer grid whose cells are eight times the
+// weld tolerance wide, and the cells are stored in an open-addressing table
+// with linear probing. Two points are welded when they are within the
+// tolerance on every axis. A query visits every cell touched by the tolerance
+// box around the point: usually one, at most 2x2x2. Points straddling a cell
+// boundary are merged the same way as points inside one cell.
+class TBWeldIndex
+{
+	public:
+		TBWeldIndex(float tolerance = DEFAULT_TOLERANCE);
+		~TBWeldIndex();
+
+		void setTolerance(float tolerance);
+		float getTolerance() const;
+
+		void clear();
+		void reserve(int numVertices);
+		int size() const;
+
+		// Returns the smallest index of a vertex within the tolerance of
+		// point, or -1. The indices stored in the table refer to vertices.
+		int find(const Vector3f &point, const Vector3f *vertices) const;
+
+		// Registers vertices[index] == point. Duplicates are allowed.
+		void insert(const Vector3f &point, int index);
+
+		static const float DEFAULT_TOLERANCE;
+
+	private:
+		struct Slot
+		{
+			int x, y, z;
+			int index;
+		};
+
+		int cellOf(float value) const;
+		static unsigned int hashCell(int x, int y, int z);
+		void rehash(int numSlots);
+
+	private:
+		float mTolerance;
+		float mInvCellSize;
+		int mCount;
+		unsigned int mMask;
+		std::vector<Slot> mSlots;
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "tridprofile.h"
+#include <algorithm>
+#include <cmath>
+
+TridProfile::TridProfile(const Circle3f& circle1, const Circle3f& circle2, const Circle3f& circle3)
+{
+    Circle3f circles[3] = { circle1, circle2, circle3 };
+    Build(circles, 3);
+}
+
+TridProfile::TridProfile(const Circle3f* circles, int numCircles)
+{
+    Build(circles, numCircles);
+}
+
+TridProfile::~TridProfile()
+{
+}
+
+float TridProfile::GetLength() const
+{
+    return (float)m_Length;
+}
+
+int TridProfile::GetNumPieces() const
+{
+    return m_Pieces.size();
+}
+
+int TridProfile::Support(double angle) const
+{
+    // The circle reaching farthest in the direction of angle.
+    double c = cos(angle);
+    double s = sin(angle);
+    int best = 0;
+    double bestValue = 0.0;
+    for (int i = 0; i < (int)m_Radii.size(); ++i)
+    {
+        double value = m_Centers[i*2] * c + m_Centers[i*2 + 1] * s + m_Radii[i];
+        if (i == 0 || value > bestValue)
+        {
+            best = i;
+            bestValue = value;
+        }
+    }
+    return best;
+}
+
+void TridProfile::Build(const Circle3f* circles, int numCircles)
+{
+    assertion(numCircles > 0, "A profile needs at least one circle.\n");
+
+    m_Centers.resize(numCircles * 2);
+    m_Radii.resize(numCircles);
+    for (int i = 0; i < numCircles; ++i)
+    {
+        m_Centers[i*2] = circles[i].Center.X();
+        m_Centers[i*2 + 1] = circles[i].Center.Y();
+        m_Radii[i] = circles[i].Radius;
+    }
+
+    // The support function of circle i is h(a) = c.u(a) + r. The winner can
+    // only change where two of them are equal:
+    //   (cx_i - cx_j) cos(a) + (cy_i - cy_j) sin(a) = r_j - r_i.
+    const double twoPi = 2.0 * Mathd::PI;
+    std::vector<double> angles;
+    angles.push_back(0.0);
+    angles.push_back(twoPi);
+    for (int i = 0; i < numCircles; ++i)
+    {
+        for (int j = i + 1; j < numCircles; ++j)
+        {
+            double a = m_Centers[i*2] - m_Centers[j*2];
+            double b = m_Centers[i*2 + 1] - m_Centers[j*2 + 1];
+            double c = m_Radii[j] - m_Radii[i];
+            double r = sqrt(a * a + b * b);
+            if (r <= 0.0 || fabs(c) > r)
+            {
+                continue;
+            }
+            double phi = atan2(b, a);
+            double delta = acos(c / r);
+            for (int k = -1; k <= 1; k += 2)
+            {
+                double angle = fmod(phi + k * delta, twoPi);
+                angles.push_back(angle < 0.0 ? angle + twoPi : angle);
+            }
+        }
+    }
+    std::sort(angles.begin(), angles.end());
+
+    // Merge the intervals won by the same circle into arcs.
+    std::vector<int> arcCircles;
+    std::vector<double> arcBegin, arcEnd;
+    for (int k = 0; k + 1 < (int)angles.size(); ++k)
+    {
+        if (angles[k + 1] - angles[k] <= 1e-12)
+        {
+            continue;
+        }
+        int winner = Support(0.5 * (angles[k] + angles[k + 1]));
+        if (!arcCircles.empty() && arcCircles.back() == winner)
+        {
+            arcEnd.back() = angles[k + 1];
+            continue;
+        }
+        arcCircles.push_back(winner);
+        arcBegin.push_back(angles[k]);
+        arcEnd.push_back(angles[k + 1]);
+    }
+    // An arc crossing angle 0 stays split in two, so the outline starts at
+    // the +x support point; no segment is put between its halves.
+
+    // Arcs alternate with the tangent segments that join them.
+    m_Pieces.clear();
+    m_Length = 0.0;
+    int numArcs = arcCircles.size();
+    for (int k = 0; k < numArcs; ++k)
+    {
+        Piece arc;
+        arc.IsArc = true;
+        arc.Circle = arcCircles[k];
+        arc.Angle0 = arcBegin[k];
+        arc.Angle1 = arcEnd[k];
+        arc.Length = m_Radii[arc.Circle] * (arc.Angle1 - arc.Angle0);
+        arc.Offset = m_Length;
+        m_Length += arc.Length;
+        if (arc.Length > 0.0)
+        {
+            m_Pieces.push_back(arc);
+        }
+
+        int next = arcCircles[(k + 1) % numArcs];
+        if (next == arc.Circle)
+        {
+            continue;
+        }
+        double angle = arc.Angle1;
+        Piece segment;
+        segment.IsArc = false;
+        segment.Circle = -1;
+        segment.Angle0 = segment.Angle1 = angle;
+        segment.Start[0] = m_Centers[arc.Circle*2] + m_Radii[arc.Circle] * cos(angle);
+        segment.Start[1] = m_Centers[arc.Circle*2 + 1] + m_Radii[arc.Circle] * sin(angle);
+        segment.End[0] = m_Centers[next*2] + m_Radii[next] * cos(angle);
+        segment.End[1] = m_Centers[next*2 + 1] + m_Radii[next] * sin(angle);
+        double dx = segment.End[0] - segment.Start[0];
+        double dy = segment.End[1] - segment.Start[1];
+        segment.Length = sqrt(dx * dx + dy * dy);
+        segment.Offset = m_Length;
+        m_Length += segment.Length;
+        if (segment.Length > 0.0)
+        {
+            m_Pieces.push_back(segment);
+        }
+    }
+}
+
+void TridProfile::Evaluate(const Piece& piece, double length, double point[2]) const
+{
+    double local = length - piece.Offset;
+    if (piece.IsArc)
+    {
+        double radius = m_Radii[piece.Circle];
+        double angle = piece.Angle0 + local / radius;
+        point[0] = m_Centers[piece.Circle*2] + radius * cos(angle);
+        point[1] = m_Centers[piece.Circle*2 + 1] + radius * sin(angle);
+        return;
+    }
+    double t = local / piece.Length;
+    point[0] = piece.Start[0] + (piece.End[0] - piece.Start[0]) * t;
+    point[1] = piece.Start[1] + (piece.End[1] - piece.Start[1]) * t;
+}
+
+Vector3f TridProfile::GetPosition(float t) const
+{
+    return GetPositionAtLength(t * (float)m_Length);
+}
+
+Vector3f TridProfile::GetPositionAtLength(float length) const
+{
+    double s = fmod((double)length, m_Length);
+    if (s < 0.0)
+    {
+        s += m_Length;
+    }
+
+    // The piece count only depends on the number of circles, so a linear
+    // scan is constant time.
+    int k = 0;
+    while (k + 1 < (int)m_Pieces.size() && m_Pieces[k + 1].Offset <= s)
+    {
+        ++k;
+    }
+    double point[2];
+    Evaluate(m_Pieces[k], s, point);
+    return Vector3f((float)point[0], (float)point[1], 0.0f);
+}
+
+void TridProfile::GetSamples(int numSamples, std::vector<Vector3f>& samples) const
+{
+    // The pieces are walked once, so emitting a whole ring is linear in the
+    // sample count.
+    samples.reserve(samples.size() + numSamples);
+    double step = m_Length / numSamples;
+    int k = 0;
+    for (int i = 0; i < numSamples; ++i)
+    {
+        double s = step * i;
+        while (k + 1 < (int)m_Pieces.size() && m_Pieces[k + 1].Offset <= s)
+        {
+            ++k;
+        }
+        double point[2];
+        Evaluate(m_Pieces[k], s, point);
+        samples.push_back(Vector3f((float)point[0], (float)point[1], 0.0f));
+    }
+}
+
+int TridProfile::GetSegmentCount(float radius, float angle, float tolerance)
+{
+    if (radius <= 0.0f || angle <= 0.0f || tolerance <= 0.0f)
+    {
+        return 1;
+    }
+    // A chord spanning the angle a deviates r (1 - cos(a/2)) from its arc.
+    double cosine = std::max(1.0 - (double)tolerance / radius, 0.0);
+    double step = 2.0 * acos(cosine);
+    int count = (int)ceil(angle / step - 1e-6);
+    return std::max(count, 1);
+}
+
+void TridProfile::GetSampleCounts(float tolerance, std::vector<int>& counts) const
+{
+    counts.resize(m_Pieces.size());
+    for (int k = 0; k < (int)m_Pieces.size(); ++k)
+    {
+        const Piece& piece = m_Pieces[k];
+        counts[k] = piece.IsArc
+            ? GetSegmentCount((float)m_Radii[piece.Circle], (float)(piece.Angle1 - piece.Angle0), tolerance)
+            : 1;
+    }
+}
+
+void TridProfile::GetSamples(const std::vector<int>& counts, std::vector<Vector3f>& samples) const
+{
+    assertion(counts.size() == m_Pieces.size(), "One sample count per piece is required.\n");
+
+    int numSamples = 0;
+    for (int k = 0; k < (int)counts.size(); ++k)
+    {
+        numSamples += counts[k];
+    }
+    samples.reserve(samples.size() + numSamples);
+    for (int k = 0; k < (int)m_Pieces.size(); ++k)
+    {
+        const Piece& piece = m_Pieces[k];
+        for (int i = 0; i < counts[k]; ++i)
+        {
+            double point[2];
+            Evaluate(piece, piece.Offset + piece.Length * i / counts[k], point);
+            samples.push_back(Vector3f((float)point[0], (float)point[1], 0.0f));
+        }
+    }
+}
+
+bool TridProfile::HasSameLayout(const TridProfile& profile) const
+{
+    if (m_Pieces.size() != profile.m_Pieces.size())
+    {
+        return false;
+    }
+    for (int k = 0; k < (int)m_Pieces.size(); ++k)
+    {
+        if (m_Pieces[k].IsArc != profile.m_Pieces[k].IsArc ||
+            m_Pieces[k].Circle != profile.m_Pieces[k].Circle)
+        {
+            return false;
+        }
+    }
+    return true;
+}
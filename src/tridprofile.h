@@ -0,0 +1,75 @@
+#ifndef TRIDPROFILE_H
+#define TRIDPROFILE_H
+
+#include "Wm5Core.h"
+#include "Wm5Mathematics.h"
+#include <vector>
+
+using namespace Wm5;
+
+// Closed outline of the convex hull of circles on the xy plane.
+//
+// The outline is an exact chain of circular arcs joined by outer tangent
+// segments, computed from the upper envelope of the circles' support
+// functions. It starts at the support point in the +x direction and runs
+// counter clockwise. Points are evaluated by arc length; the chain has fewer
+// than four pieces per circle, so every evaluation is constant time.
+class TridProfile
+{
+public:
+    TridProfile(const Circle3f& circle1, const Circle3f& circle2, const Circle3f& circle3);
+    TridProfile(const Circle3f* circles, int numCircles);
+    ~TridProfile();
+
+    float GetLength() const;
+    int GetNumPieces() const;
+
+    // t in [0,1] is the fraction of the total length.
+    Vector3f GetPosition(float t) const;
+    Vector3f GetPositionAtLength(float length) const;
+
+    // Appends numSamples points evenly spaced in arc length, the first at
+    // the start of the outline.
+    void GetSamples(int numSamples, std::vector<Vector3f>& samples) const;
+
+    // Number of samples per piece keeping every chord within tolerance of the
+    // outline. Arcs get as many as their radius and angle need; segments are
+    // exact with one.
+    void GetSampleCounts(float tolerance, std::vector<int>& counts) const;
+
+    // Appends counts[k] points evenly spaced along piece k, the first at its
+    // start.
+    void GetSamples(const std::vector<int>& counts, std::vector<Vector3f>& samples) const;
+
+    // Profiles with the same layout have the same pieces in the same order,
+    // so sampling them with the same counts gives matching topology.
+    bool HasSameLayout(const TridProfile& profile) const;
+
+    // Smallest number of chords splitting an arc so that none deviates more
+    // than tolerance from it; at least one.
+    static int GetSegmentCount(float radius, float angle, float tolerance);
+
+private:
+    struct Piece
+    {
+        // Arcs use the circle and the angle range, segments the end points.
+        bool IsArc;
+        int Circle;
+        double Angle0, Angle1;
+        double Start[2], End[2];
+        double Length;
+        double Offset;
+    };
+
+    void Build(const Circle3f* circles, int numCircles);
+    int Support(double angle) const;
+    void Evaluate(const Piece& piece, double length, double point[2]) const;
+
+private:
+    std::vector<double> m_Centers;
+    std::vector<double> m_Radii;
+    std::vector<Piece> m_Pieces;
+    double m_Length;
+};
+
+#endif